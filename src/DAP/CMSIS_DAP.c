@@ -57,6 +57,16 @@
 #define CLOCK_DELAY(swj_clock) \
  (((CPU_CLOCK/2U) / swj_clock) - IO_PORT_WRITE_CYCLES)
 
+// SWCLK period in 1/16 CPU cycles, modelled as ClockPeriodBase plus
+// ClockPeriodStep per unit of clock_delay. The nominal cycle counts are
+// used until DAP_CalibrateClock has measured the delay loops.
+#define CLOCK_PERIOD_SHIFT      4U
+
+static uint32_t ClockPeriodBase = (2U * IO_PORT_WRITE_CYCLES) << CLOCK_PERIOD_SHIFT;
+static uint32_t ClockPeriodStep = (2U * DELAY_SLOW_CYCLES)    << CLOCK_PERIOD_SHIFT;
+static uint32_t ClockRequested  = DAP_DEFAULT_SWJ_CLOCK;        // Requested SWJ clock in Hz
+static uint32_t ClockActual;                                    // Achieved SWJ clock in Hz
+
 
          DAP_Data_t DAP_Data;           // DAP Data
 volatile uint8_t    DAP_TransferAbort;  // Transfer Abort Flag
@@ -78,6 +88,7 @@ static const char TargetBoardName    [] = TARGET_BOARD_NAME;
 static const char Product_FW_Ver [] = PRODUCT_FW_VER;
 
 static char SerialNumber[DAP_SERIAL_NUM_LENGTH+1] = "000000000000000000000000";
+static uint16_t PacketSize = DAP_PACKET_SIZE;
 
 // Get DAP Information
 //   id:      info identifier
@@ -94,8 +105,11 @@ static uint8_t DAP_Info(uint8_t id, uint8_t *info) {
       length = DAP_GetProductString((char *)info);
       break;
     case DAP_ID_SER_NUM:
+      // Always DAP_SERIAL_NUM_LENGTH bytes, zero-padded, as hosts have seen it
+      length = (uint8_t)strnlen(SerialNumber, DAP_SERIAL_NUM_LENGTH);
+      memcpy(info, SerialNumber, length);
+      memset(&info[length], 0, DAP_SERIAL_NUM_LENGTH - length);
       length = DAP_SERIAL_NUM_LENGTH;
-      strncpy((char*)info, SerialNumber, DAP_SERIAL_NUM_LENGTH);
       break;
     case DAP_ID_DAP_FW_VER:
       length = (uint8_t)sizeof(DAP_FW_Ver);
@@ -175,14 +189,23 @@ static uint8_t DAP_Info(uint8_t id, uint8_t *info) {
 #endif
       break;
     case DAP_ID_PACKET_SIZE:
-      info[0] = (uint8_t)(DAP_PACKET_SIZE >> 0);
-      info[1] = (uint8_t)(DAP_PACKET_SIZE >> 8);
+      info[0] = (uint8_t)(PacketSize >> 0);
+      info[1] = (uint8_t)(PacketSize >> 8);
       length = 2U;
       break;
     case DAP_ID_PACKET_COUNT:
       info[0] = DAP_PACKET_COUNT;
       length = 1U;
       break;
+    case DAP_ID_SWJ_CLOCK_ACTUAL:
+#if ((DAP_SWD != 0) || (DAP_JTAG != 0))
+      info[0] = (uint8_t)(ClockActual >>  0);
+      info[1] = (uint8_t)(ClockActual >>  8);
+      info[2] = (uint8_t)(ClockActual >> 16);
+      info[3] = (uint8_t)(ClockActual >> 24);
+      length = 4U;
+#endif
+      break;
     default:
       break;
   }
@@ -406,6 +429,35 @@ static uint32_t DAP_SWJ_Pins(const uint8_t *request, uint8_t *response) {
 }
 
 
+// Select the clock delay for an SWJ clock frequency
+//   clock:  requested frequency in Hz, rounded down to the nearest achievable
+//   return: none
+static void DAP_SetClock(uint32_t clock) {
+  uint32_t period;
+  uint32_t delay;
+
+  ClockRequested = clock;
+
+  if (clock >= MAX_SWJ_CLOCK(DELAY_FAST_CYCLES)) {
+    DAP_Data.fast_clock  = 1U;
+    DAP_Data.clock_delay = 1U;
+    ClockActual = MAX_SWJ_CLOCK(DELAY_FAST_CYCLES);
+  } else {
+    DAP_Data.fast_clock  = 0U;
+
+    period = ((CPU_CLOCK << CLOCK_PERIOD_SHIFT) + (clock - 1U)) / clock;
+    if (period > (ClockPeriodBase + ClockPeriodStep)) {
+      delay = ((period - ClockPeriodBase) + (ClockPeriodStep - 1U)) / ClockPeriodStep;
+    } else {
+      delay = 1U;
+    }
+
+    DAP_Data.clock_delay = delay;
+    ClockActual = (CPU_CLOCK << CLOCK_PERIOD_SHIFT) / (ClockPeriodBase + (ClockPeriodStep * delay));
+  }
+}
+
+
 // Process SWJ Clock command and prepare response
 //   request:  pointer to request data
 //   response: pointer to response data
@@ -414,7 +466,6 @@ static uint32_t DAP_SWJ_Pins(const uint8_t *request, uint8_t *response) {
 static uint32_t DAP_SWJ_Clock(const uint8_t *request, uint8_t *response) {
 #if ((DAP_SWD != 0) || (DAP_JTAG != 0))
   uint32_t clock;
-  uint32_t delay;
 
   clock = (uint32_t)(*(request+0) <<  0) |
           (uint32_t)(*(request+1) <<  8) |
@@ -426,22 +477,7 @@ static uint32_t DAP_SWJ_Clock(const uint8_t *request, uint8_t *response) {
     return ((4U << 16) | 1U);
   }
 
-  if (clock >= MAX_SWJ_CLOCK(DELAY_FAST_CYCLES)) {
-    DAP_Data.fast_clock  = 1U;
-    DAP_Data.clock_delay = 1U;
-  } else {
-    DAP_Data.fast_clock  = 0U;
-
-    delay = ((CPU_CLOCK/2U) + (clock - 1U)) / clock;
-    if (delay > IO_PORT_WRITE_CYCLES) {
-      delay -= IO_PORT_WRITE_CYCLES;
-      delay  = (delay + (DELAY_SLOW_CYCLES - 1U)) / DELAY_SLOW_CYCLES;
-    } else {
-      delay  = 1U;
-    }
-
-    DAP_Data.clock_delay = delay;
-  }
+  DAP_SetClock(clock);
 
   *response = DAP_OK;
 #else
@@ -466,6 +502,9 @@ static uint32_t DAP_SWJ_Sequence(const uint8_t *request, uint8_t *response) {
   }
 
 #if ((DAP_SWD != 0) || (DAP_JTAG != 0))
+#if (DAP_SWD != 0)
+  SWD_TrackSequence(count, request);
+#endif
   SWJ_Sequence(count, request);
   *response = DAP_OK;
 #else
@@ -720,6 +759,10 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
 #if (TIMESTAMP_CLOCK != 0U)
   uint32_t  timestamp;
 #endif
+#if (DAP_SWD_BATCH != 0)
+  uint32_t  request_size;
+  uint32_t  n;
+#endif
 
   request_head   = request;
 
@@ -737,6 +780,26 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
 
   request_count = *request++;
 
+#if (DAP_SWD_BATCH != 0)
+  // Parse the whole request first: without value match, match mask or
+  // timestamps it is run as one batch
+  request_size = 0U;
+  for (n = request_count; n != 0U; n--) {
+    request_value = *(request + request_size);
+    if ((request_value & (DAP_TRANSFER_MATCH_VALUE | DAP_TRANSFER_MATCH_MASK | DAP_TRANSFER_TIMESTAMP)) != 0U) {
+      break;
+    }
+    request_size += ((request_value & DAP_TRANSFER_RnW) != 0U) ? 1U : 5U;
+  }
+  if (n == 0U) {
+    n = SWD_TransferBatch(request, request_count, response);
+    *(response_head+0) = (uint8_t)(n >> 8);
+    *(response_head+1) = (uint8_t) n;
+    request += request_size;
+    return (((uint32_t)(request - request_head) << 16) | ((n >> 16) + 2U));
+  }
+#endif
+
   while (request_count != 0) {
     request_count--;
     request_value = *request++;
@@ -910,7 +973,8 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
           *response++ = (uint8_t)(timestamp >> 24);
         }
 #endif
-        check_write = 1U;
+        // Nothing answers until DPIDR has been read after a TARGETSEL
+        check_write = ((request_value & 0x0FU) != DP_TARGETSEL) ? 1U : 0U;
       }
     }
     response_count++;
@@ -1799,8 +1863,11 @@ uint32_t DAP_ProcessCommand(const uint8_t *request, uint8_t *response) {
 uint32_t DAP_ExecuteCommand(const uint8_t *request, uint8_t *response) {
   uint32_t cnt, num, n;
 
-  if (*request == ID_DAP_ExecuteCommands) {
-    *response++ = *request++;
+  // Queued commands run straight away; only their responses are held back,
+  // which the transport takes care of. Both answer as DAP_ExecuteCommands.
+  if ((*request == ID_DAP_ExecuteCommands) || (*request == ID_DAP_QueueCommands)) {
+    *response++ = ID_DAP_ExecuteCommands;
+    request++;
     cnt = *request++;
     *response++ = (uint8_t)cnt;
     num = (2U << 16) | 2U;
@@ -1825,13 +1892,23 @@ void DAP_SetSerial(const char* serial) {
   }
 }
 
+// Set the packet size reported by DAP_Info
+// The transport that carries a command may use packets smaller than DAP_PACKET_SIZE
+void DAP_SetPacketSize(uint16_t size) {
+  PacketSize = size;
+}
+
+uint16_t DAP_GetPacketSize(void) {
+  return PacketSize;
+}
+
 // Setup DAP
 void DAP_Setup(void) {
 
   // Default settings (only non-zero values)
 //DAP_Data.debug_port  = 0U;
 //DAP_Data.fast_clock  = 0U;
-  DAP_Data.clock_delay = CLOCK_DELAY(DAP_DEFAULT_SWJ_CLOCK);
+  DAP_SetClock(DAP_DEFAULT_SWJ_CLOCK);
 //DAP_Data.transfer.idle_cycles = 0U;
   DAP_Data.transfer.retry_count = 100U;
 //DAP_Data.transfer.match_retry = 0U;
@@ -1839,6 +1916,8 @@ void DAP_Setup(void) {
 #if (DAP_SWD != 0)
   DAP_Data.swd_conf.turnaround  = 1U;
 //DAP_Data.swd_conf.data_phase  = 0U;
+//DAP_Data.swd_conf.wait_idle   = 0U;
+//DAP_Data.swd_conf.wait_idle_max = 0U;
 #endif
 #if (DAP_JTAG != 0)
 //DAP_Data.jtag_dev.count = 0U;
@@ -1846,3 +1925,68 @@ void DAP_Setup(void) {
 
   DAP_SETUP();  // Device specific setup
 }
+
+
+#if (SWJ_CLOCK_CALIBRATION != 0) && ((DAP_SWD != 0) || (DAP_JTAG != 0))
+
+#define CLOCK_CAL_BITS          256U    // SWCLK cycles per measurement
+#define CLOCK_CAL_DELAY         16U     // Extra clock delay to measure the step
+#define CLOCK_CAL_RUNS          4U      // Fastest run is kept, to skip interrupts
+
+// Time an SWJ sequence with a given clock delay
+//   delay:  clock delay to time
+//   return: fastest time for CLOCK_CAL_BITS SWCLK cycles, in timer counts
+static uint32_t DAP_TimeClock(uint32_t delay) {
+  static const uint8_t bits[CLOCK_CAL_BITS/8U];
+  uint32_t best = UINT32_MAX;
+  uint32_t start;
+  uint32_t elapsed;
+  uint32_t n;
+
+  DAP_Data.clock_delay = delay;
+  for (n = 0U; n < CLOCK_CAL_RUNS; n++) {
+    start = CLOCK_CALIBRATION_TIMER_GET();
+    SWJ_Sequence(CLOCK_CAL_BITS, bits);
+    elapsed = CLOCK_CALIBRATION_TIMER_GET() - start;
+    if (elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  return (best);
+}
+
+#endif
+
+// Calibrate the SWJ clock delays against a timer and reselect the clock.
+// Called at boot with the debug port off, once the timer is running. Only
+// the SWJ_Sequence loop is timed, as the others need a target to answer,
+// so the clock of the other loops is an estimate.
+void DAP_CalibrateClock(void) {
+#if (SWJ_CLOCK_CALIBRATION != 0) && ((DAP_SWD != 0) || (DAP_JTAG != 0))
+  uint32_t counts_per_us;
+  uint32_t period1;
+  uint32_t period2;
+  uint32_t step;
+
+  counts_per_us = CLOCK_CALIBRATION_TIMER_COUNTS_PER_US();
+  if (counts_per_us == 0U) {
+    return;
+  }
+
+  // Convert timer counts for CLOCK_CAL_BITS cycles into 1/16 CPU cycles per cycle
+  period1 = DAP_TimeClock(1U);
+  period2 = DAP_TimeClock(1U + CLOCK_CAL_DELAY);
+  period1 = (period1 * (CPU_CLOCK/1000000U)) / (counts_per_us * (CLOCK_CAL_BITS >> CLOCK_PERIOD_SHIFT));
+  period2 = (period2 * (CPU_CLOCK/1000000U)) / (counts_per_us * (CLOCK_CAL_BITS >> CLOCK_PERIOD_SHIFT));
+
+  // Keep the nominal model if the timer isn't running
+  step = (period2 > period1) ? ((period2 - period1) / CLOCK_CAL_DELAY) : 0U;
+  if ((step != 0U) && (period1 > step)) {
+    ClockPeriodStep = step;
+    ClockPeriodBase = period1 - step;
+  }
+#endif
+
+  DAP_SetClock(ClockRequested);
+}
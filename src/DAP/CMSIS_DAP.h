@@ -136,6 +136,9 @@
 #define DAP_ID_PACKET_COUNT             0xFEU
 #define DAP_ID_PACKET_SIZE              0xFFU
 
+// dap42 vendor DAP ID, outside the IDs defined by CMSIS-DAP
+#define DAP_ID_SWJ_CLOCK_ACTUAL         0x80U   // Estimated SWJ clock in Hz
+
 // DAP Host Status
 #define DAP_DEBUGGER_CONNECTED          0U
 #define DAP_TARGET_RUNNING              1U
@@ -214,6 +217,7 @@
 #define DP_SELECT                       0x08U   // Select Register (JTAG R/W & SW W)
 #define DP_RESEND                       0x08U   // Resend (SW Read Only)
 #define DP_RDBUFF                       0x0CU   // Read Buffer (Read Only)
+#define DP_TARGETSEL                    0x0CU   // Target Select (SW Write only)
 
 // JTAG IR Codes
 #define JTAG_ABORT                      0x08U
@@ -252,6 +256,8 @@ typedef struct {
   struct {                                      // SWD Configuration
     uint8_t    turnaround;                      // Turnaround period
     uint8_t    data_phase;                      // Always generate Data Phase
+    uint16_t   wait_idle;                       // Idle cycles before a retry after WAIT
+    uint16_t   wait_idle_max;                   // Limit as wait_idle doubles on repeated WAIT
   } swd_conf;
 #endif
 #if (DAP_JTAG != 0)
@@ -270,6 +276,21 @@ typedef struct {
 extern          DAP_Data_t DAP_Data;            // DAP Data
 extern volatile uint8_t    DAP_TransferAbort;   // Transfer Abort Flag
 
+// Host's DP and MEM-AP registers, saved around accesses of the probe's own
+typedef struct {
+  uint32_t select;
+  uint32_t csw;
+  uint32_t tar;
+} MEM_Saved_t;
+
+
+// Mark a function that stays in flash but is called from a RAMFUNC: a BL from
+// RAM can't reach flash, so such calls have to load the address instead.
+#if defined(DAP_RAMFUNCS)
+#define FLASHCALL __attribute__((long_call))
+#else
+#define FLASHCALL
+#endif
 
 // Functions
 extern void     SWJ_Sequence    (uint32_t count, const uint8_t *data);
@@ -279,7 +300,13 @@ extern void     JTAG_IR         (uint32_t ir);
 extern uint32_t JTAG_ReadIDCode (void);
 extern void     JTAG_WriteAbort (uint32_t data);
 extern uint8_t  JTAG_Transfer   (uint32_t request, uint32_t *data);
-extern uint8_t  SWD_Transfer    (uint32_t request, uint32_t *data);
+extern uint32_t JTAG_GetSelect  (uint32_t index, uint32_t *select);
+extern uint8_t  SWD_Transfer    (uint32_t request, uint32_t *data) FLASHCALL;
+extern uint32_t SWD_TransferBatch(const uint8_t *request, uint32_t count, uint8_t *response);
+extern void     SWD_TrackSequence(uint32_t count, const uint8_t *data);
+extern void     SWD_TargetSelect(uint32_t targetsel);
+extern uint32_t SWD_GetSelect   (uint32_t *select);
+extern void     SWD_ReadAckStats(uint32_t *stats, uint32_t clear);
 
 extern void     Delayms         (uint32_t delay);
 
@@ -291,9 +318,11 @@ extern uint32_t SWO_Status                                 (uint8_t *response);
 extern uint32_t SWO_ExtendedStatus (const uint8_t *request, uint8_t *response);
 extern uint32_t SWO_Data           (const uint8_t *request, uint8_t *response);
 
-extern void     SWO_QueueTransfer    (uint8_t *buf, uint32_t num);
+extern uint32_t SWO_QueueTransfer    (uint8_t *buf, uint32_t num);
 extern void     SWO_AbortTransfer    (void);
 extern void     SWO_TransferComplete (void);
+extern void     SWO_Process          (void);
+extern uint32_t SWO_Streaming        (void);
 
 extern uint32_t SWO_Mode_UART     (uint32_t enable);
 extern uint32_t SWO_Baudrate_UART (uint32_t baudrate);
@@ -312,6 +341,53 @@ extern uint32_t UART_Configure (const uint8_t *request, uint8_t *response);
 extern uint32_t UART_Control   (const uint8_t *request, uint8_t *response);
 extern uint32_t UART_Status                            (uint8_t *response);
 extern uint32_t UART_Transfer  (const uint8_t *request, uint8_t *response);
+extern uint32_t UART_Stats     (const uint8_t *request, uint8_t *response);
+
+extern uint32_t MEM_Read       (const uint8_t *request, uint8_t *response);
+extern uint32_t MEM_ReadNext                             (uint8_t *response);
+extern uint32_t MEM_ReadPending(void);
+extern void     MEM_ReadCancel (void);
+extern uint32_t MEM_Write      (const uint8_t *request, uint8_t *response);
+extern uint8_t  MEM_WriteBlock (uint8_t index, uint32_t size, uint32_t addr,
+                                const uint8_t *data, uint32_t len, uint32_t *count);
+extern uint8_t  MEM_ReadBlock  (uint8_t index, uint32_t addr, uint8_t *data, uint32_t len);
+extern uint8_t  MEM_GetCsw     (uint8_t index, uint32_t size, uint32_t *csw);
+extern uint8_t  MEM_GetCswTar  (uint8_t index, uint32_t *csw, uint32_t *tar);
+extern uint8_t  MEM_SetCswTar  (uint8_t index, uint32_t csw, uint32_t tar);
+extern uint8_t  MEM_GetAp      (uint8_t index, uint32_t *ap);
+extern uint8_t  MEM_ClaimAp    (uint8_t index, uint32_t ap, MEM_Saved_t *saved);
+extern uint8_t  MEM_ReleaseAp  (uint8_t index, const MEM_Saved_t *saved, uint8_t ack);
+extern uint32_t MEM_Crc32      (const uint8_t *request, uint8_t *response, uint32_t resumable);
+extern uint32_t MEM_Crc32Next                            (uint8_t *response);
+extern uint32_t MEM_Crc32Pending(void);
+extern void     MEM_Crc32Cancel(void);
+extern uint32_t MEM_Watch      (const uint8_t *request, uint8_t *response);
+extern uint32_t MEM_WatchDue   (void);
+extern void     MEM_WatchPoll  (void);
+extern uint32_t MEM_WatchEvent (const uint8_t *request, uint8_t *response);
+extern void     MEM_WatchCancel(void);
+extern uint32_t FLASH_Setup    (const uint8_t *request, uint8_t *response);
+extern uint32_t FLASH_Program  (const uint8_t *request, uint8_t *response, uint32_t resumable);
+extern uint32_t FLASH_Finish   (const uint8_t *request, uint8_t *response, uint32_t resumable);
+extern uint32_t FLASH_Next                               (uint8_t *response);
+extern uint32_t FLASH_Pending  (void);
+extern void     FLASH_Cancel   (void);
+extern uint32_t RTT_Start      (const uint8_t *request, uint8_t *response, uint32_t resumable);
+extern uint32_t RTT_Next                                 (uint8_t *response);
+extern uint32_t RTT_Pending    (void);
+extern uint32_t RTT_Due        (void);
+extern uint32_t RTT_Active     (void);
+extern void     RTT_Poll       (void);
+extern void     RTT_Stop       (void);
+extern uint32_t SAMPLE_Start   (const uint8_t *request, uint8_t *response);
+extern uint32_t SAMPLE_Due     (void);
+extern void     SAMPLE_Poll    (void);
+extern void     SAMPLE_Release (void);
+extern void     SAMPLE_Stop    (void);
+extern void     SAMPLE_Reset   (void);
+extern uint32_t SAMPLE_QueueTransfer (uint8_t *buf, uint32_t num);
+extern uint32_t GANG_Sequence  (const uint8_t *request, uint8_t *response);
+extern uint32_t GANG_Transfer  (const uint8_t *request, uint8_t *response);
 
 extern uint8_t  USB_COM_PORT_Activate (uint32_t cmd);
 
@@ -320,12 +396,20 @@ extern uint32_t DAP_ProcessCommand       (const uint8_t *request, uint8_t *respo
 extern uint32_t DAP_ExecuteCommand       (const uint8_t *request, uint8_t *response);
 
 extern void     DAP_SetSerial(const char* serial);
+extern void     DAP_SetPacketSize(uint16_t size);
+extern uint16_t DAP_GetPacketSize(void);
 extern void     DAP_Setup (void);
+extern void     DAP_CalibrateClock (void);
 
 #ifndef __forceinline
 #define __forceinline __attribute__((always_inline))
 #endif
 
+// Run a function from RAM, for the functions listed in RAMFUNCS at build time.
+// The function goes in a .data_ramtext.* section, which the *(.data*) pattern
+// of the common linker script copies to RAM at startup along with .data.
+#define RAMFUNC(name) __attribute__((noinline, long_call, section(".data_ramtext." #name)))
+
 // Configurable delay for clock generation
 #ifndef DELAY_SLOW_CYCLES
 #define DELAY_SLOW_CYCLES       3U      // Number of cycles for one iteration
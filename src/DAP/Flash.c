@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2026, Devan Lai
+ *
+ * Permission to use, copy, modify, and/or distribute this software
+ * for any purpose with or without fee is hereby granted, provided
+ * that the above copyright notice and this permission notice
+ * appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "DAP/CMSIS_DAP_hal.h"
+#include "DAP/CMSIS_DAP.h"
+
+#if (DAP_FLASH != 0)
+
+#if (DAP_MEMORY == 0)
+#error "Flash programming writes the pages with the memory engine: set DAP_MEMORY"
+#endif
+
+/*
+ * Flash programming with a flash algorithm that the host has already loaded
+ * into target RAM and initialized, with the core halted. The host registers
+ * the algorithm's ProgramPage entry point and two page buffers in target RAM
+ * once, then just streams the data.
+ *
+ * The probe copies the data into one buffer while the algorithm programs the
+ * page in the other, and only waits for the core to halt on the breakpoint
+ * once the next page is ready to go. A failed page is remembered until the
+ * next setup, so a host that keeps several requests in flight finds out on
+ * the next response.
+ *
+ * When a request is sent on its own, waiting for the core is done one poll
+ * per FLASH_Next call, so that the main loop keeps running meanwhile.
+ */
+
+// MEM-AP registers, as DAP_Transfer request bits
+#define FLASH_AP_CSW            (DAP_TRANSFER_APnDP)
+#define FLASH_AP_TAR            (DAP_TRANSFER_APnDP | DAP_TRANSFER_A2)
+#define FLASH_AP_DRW            (DAP_TRANSFER_APnDP | DAP_TRANSFER_A2 | DAP_TRANSFER_A3)
+
+// Cortex-M debug registers
+#define FLASH_DHCSR             0xE000EDF0U
+#define FLASH_DCRSR             0xE000EDF4U
+#define FLASH_DCRDR             0xE000EDF8U
+
+#define FLASH_DHCSR_DBGKEY      0xA05F0000U
+#define FLASH_DHCSR_C_DEBUGEN   (1U << 0)
+#define FLASH_DHCSR_C_HALT      (1U << 1)
+#define FLASH_DHCSR_S_HALT      (1U << 17)
+#define FLASH_DCRSR_REGWnR      (1U << 16)
+
+#define FLASH_REG_R0            0U
+#define FLASH_REG_R1            1U
+#define FLASH_REG_R2            2U
+#define FLASH_REG_R9            9U
+#define FLASH_REG_SP            13U
+#define FLASH_REG_LR            14U
+#define FLASH_REG_PC            15U
+#define FLASH_REG_XPSR          16U
+
+#define FLASH_XPSR_T            (1U << 24)
+
+/// The algorithm returned an error code in R0
+#define FLASH_STATUS_FAILED     0x20U
+/// The algorithm didn't return in time and the core was halted
+#define FLASH_STATUS_TIMEOUT    0x40U
+
+/// Time allowed for one ProgramPage call
+#define FLASH_TIMEOUT_MS        1000U
+
+#define FLASH_SETUP_SIZE        30U
+#define FLASH_RESPONSE_SIZE     10U
+
+static struct {
+    bool     ready;         ///< Set up and not failed since
+    uint8_t  status;        ///< Why programming stopped
+    uint8_t  index;         ///< DAP index of the JTAG device
+    uint32_t csw;
+    uint32_t program_page;
+    uint32_t breakpoint;
+    uint32_t stack;
+    uint32_t static_base;
+    uint32_t buffer[2];
+    uint32_t page_size;
+
+    uint8_t  fill;          ///< Buffer being filled
+    uint32_t fill_addr;     ///< Flash address of its first byte
+    uint32_t fill_len;
+    bool     busy;          ///< The algorithm is programming the other buffer
+    uint32_t busy_addr;
+    uint32_t started;       ///< Timestamp of the running call
+    uint32_t result;        ///< R0 of the failed call
+
+    const uint8_t* data;    ///< Rest of the request being worked on
+    uint32_t addr;
+    uint32_t len;
+    bool     flush;         ///< Program what's buffered and wait for it
+    bool     pending;
+} flash;
+
+static uint32_t flash_get32(const uint8_t* buf) {
+    return ((uint32_t)buf[0] <<  0) |
+           ((uint32_t)buf[1] <<  8) |
+           ((uint32_t)buf[2] << 16) |
+           ((uint32_t)buf[3] << 24);
+}
+
+static void flash_put32(uint8_t* buf, uint32_t value) {
+    buf[0] = (uint8_t)(value >>  0);
+    buf[1] = (uint8_t)(value >>  8);
+    buf[2] = (uint8_t)(value >> 16);
+    buf[3] = (uint8_t)(value >> 24);
+}
+
+// Append one register write to a DAP_Transfer request
+static uint32_t flash_add_write(uint8_t* request, uint32_t n, uint8_t reg, uint32_t value) {
+    request[n] = reg;
+    flash_put32(&request[n + 1U], value);
+    request[2]++;
+    return n + 5U;
+}
+
+// Append a write to a debug register to a DAP_Transfer request
+static uint32_t flash_add_debug_write(uint8_t* request, uint32_t n, uint32_t addr, uint32_t value) {
+    n = flash_add_write(request, n, FLASH_AP_TAR, addr);
+    return flash_add_write(request, n, FLASH_AP_DRW, value);
+}
+
+// Append a core register write through DCRDR and DCRSR. Each one takes far
+// longer to send than the core takes to transfer the register, so S_REGRDY
+// isn't polled in between.
+static uint32_t flash_add_core_write(uint8_t* request, uint32_t n, uint32_t reg, uint32_t value) {
+    n = flash_add_debug_write(request, n, FLASH_DCRDR, value);
+    return flash_add_debug_write(request, n, FLASH_DCRSR, FLASH_DCRSR_REGWnR | reg);
+}
+
+// Read a debug register, or R0 when reg_r0 is set
+static uint8_t flash_read(uint32_t addr, bool reg_r0, uint32_t* value) {
+    uint8_t request[3U + (4U * 5U) + 1U] = { ID_DAP_Transfer, flash.index, 0U };
+    uint8_t response[3U + 4U];
+    uint32_t n = 3U;
+
+    n = flash_add_write(request, n, FLASH_AP_CSW, flash.csw);
+    if (reg_r0) {
+        n = flash_add_debug_write(request, n, FLASH_DCRSR, FLASH_REG_R0);
+    }
+    n = flash_add_write(request, n, FLASH_AP_TAR, addr);
+    request[n] = FLASH_AP_DRW | DAP_TRANSFER_RnW;
+    request[2]++;
+
+    DAP_ProcessCommand(request, response);
+    *value = flash_get32(&response[3]);
+    return response[2];
+}
+
+// Call ProgramPage(addr, len, buffer) and let the core run
+static uint8_t flash_start(uint32_t buffer, uint32_t addr, uint32_t len) {
+    uint8_t request[3U + (5U * 35U)] = { ID_DAP_Transfer, flash.index, 0U };
+    uint8_t response[3];
+    uint32_t n = 3U;
+
+    n = flash_add_write(request, n, FLASH_AP_CSW, flash.csw);
+    n = flash_add_core_write(request, n, FLASH_REG_R0, addr);
+    n = flash_add_core_write(request, n, FLASH_REG_R1, len);
+    n = flash_add_core_write(request, n, FLASH_REG_R2, buffer);
+    n = flash_add_core_write(request, n, FLASH_REG_R9, flash.static_base);
+    n = flash_add_core_write(request, n, FLASH_REG_SP, flash.stack);
+    n = flash_add_core_write(request, n, FLASH_REG_LR, flash.breakpoint | 1U);
+    n = flash_add_core_write(request, n, FLASH_REG_PC, flash.program_page);
+    n = flash_add_core_write(request, n, FLASH_REG_XPSR, FLASH_XPSR_T);
+    (void)flash_add_debug_write(request, n, FLASH_DHCSR,
+                                FLASH_DHCSR_DBGKEY | FLASH_DHCSR_C_DEBUGEN);
+
+    DAP_ProcessCommand(request, response);
+    return response[2];
+}
+
+// Halt the core in the middle of a call that didn't return in time
+static void flash_halt(void) {
+    uint8_t request[3U + (5U * 3U)] = { ID_DAP_Transfer, flash.index, 0U };
+    uint8_t response[3];
+    uint32_t n = 3U;
+
+    n = flash_add_write(request, n, FLASH_AP_CSW, flash.csw);
+    (void)flash_add_debug_write(request, n, FLASH_DHCSR, FLASH_DHCSR_DBGKEY |
+                                FLASH_DHCSR_C_DEBUGEN | FLASH_DHCSR_C_HALT);
+    DAP_ProcessCommand(request, response);
+}
+
+static void flash_fail(uint8_t status, uint32_t result, uint32_t addr) {
+    flash.ready = false;
+    flash.status = status;
+    flash.result = result;
+    flash.busy_addr = addr;
+    flash.busy = false;
+}
+
+// Check once whether the running call has returned
+//   return: true while it's still running
+static bool flash_poll(void) {
+    uint32_t dhcsr = 0U;
+    uint32_t r0 = 0U;
+    uint8_t ack;
+
+    ack = flash_read(FLASH_DHCSR, false, &dhcsr);
+    if (ack != DAP_TRANSFER_OK) {
+        flash_fail(ack, 0U, flash.busy_addr);
+        return false;
+    }
+
+    if ((dhcsr & FLASH_DHCSR_S_HALT) == 0U) {
+        if ((TIMESTAMP_GET() - flash.started) <= (FLASH_TIMEOUT_MS * (TIMESTAMP_CLOCK / 1000U))) {
+            return true;
+        }
+        flash_halt();
+        flash_fail(FLASH_STATUS_TIMEOUT, 0U, flash.busy_addr);
+        return false;
+    }
+
+    ack = flash_read(FLASH_DCRDR, true, &r0);
+    if (ack != DAP_TRANSFER_OK) {
+        flash_fail(ack, 0U, flash.busy_addr);
+    } else if (r0 != 0U) {
+        flash_fail(FLASH_STATUS_FAILED, r0, flash.busy_addr);
+    } else {
+        flash.busy = false;
+    }
+    return false;
+}
+
+// Work through the current request until it's done or has to wait
+//   return: true while waiting for the algorithm
+static bool flash_step(void) {
+    while (flash.ready) {
+        bool start = false;
+
+        if (flash.len != 0U) {
+            uint32_t end = flash.fill_addr + flash.fill_len;
+            if (flash.fill_len == 0U) {
+                flash.fill_addr = flash.addr;
+                end = flash.addr;
+            }
+
+            // A gap in the data ends the page early
+            if (end != flash.addr) {
+                start = true;
+            } else {
+                uint32_t n = ((end | (flash.page_size - 1U)) + 1U) - end;
+                uint32_t written = 0U;
+                uint8_t ack;
+
+                if (n > flash.len) {
+                    n = flash.len;
+                }
+                ack = MEM_WriteBlock(flash.index, 2U, flash.buffer[flash.fill] + flash.fill_len,
+                                     flash.data, n, &written);
+                if (ack != DAP_TRANSFER_OK) {
+                    flash_fail(ack, 0U, flash.fill_addr);
+                    break;
+                }
+                flash.data += n;
+                flash.addr += n;
+                flash.len -= n;
+                flash.fill_len += n;
+                if (((end + n) & (flash.page_size - 1U)) != 0U) {
+                    continue;
+                }
+                start = true;
+            }
+        } else if (flash.flush && (flash.fill_len != 0U)) {
+            start = true;
+        } else if (!(flash.flush && flash.busy)) {
+            break;
+        }
+
+        // Only one page can be programmed at a time
+        if (flash.busy && flash_poll()) {
+            return true;
+        }
+        if (!start || !flash.ready) {
+            continue;
+        }
+
+        uint8_t ack = flash_start(flash.buffer[flash.fill], flash.fill_addr, flash.fill_len);
+        if (ack != DAP_TRANSFER_OK) {
+            flash_fail(ack, 0U, flash.fill_addr);
+            break;
+        }
+        flash.busy = true;
+        flash.busy_addr = flash.fill_addr;
+        flash.started = TIMESTAMP_GET();
+        flash.fill ^= 1U;
+        flash.fill_addr += flash.fill_len;
+        flash.fill_len = 0U;
+    }
+
+    flash.len = 0U;
+    return false;
+}
+
+// Take on a Flash Program or Flash Finish request and work on it as far as
+// possible, leaving the rest to FLASH_Next
+//   return: number of bytes in response (lower 16 bits)
+//           number of bytes in request (upper 16 bits)
+static uint32_t flash_run(const uint8_t* request, uint8_t* response, uint32_t request_bytes) {
+    response[0] = request[0];
+    flash.pending = flash_step();
+    if (!flash.pending) {
+        FLASH_Next(response);
+    }
+    return ((request_bytes << 16) | FLASH_RESPONSE_SIZE);
+}
+
+// Answer a Flash Program or Flash Finish request that can't be taken on
+//   return: number of bytes in response (lower 16 bits)
+//           number of bytes in request (upper 16 bits)
+static uint32_t flash_reject(const uint8_t* request, uint8_t* response, uint32_t request_bytes) {
+    response[0] = request[0];
+    response[1] = DAP_ERROR;
+    memset(&response[2], 0, FLASH_RESPONSE_SIZE - 2U);
+    return ((request_bytes << 16) | FLASH_RESPONSE_SIZE);
+}
+
+// Process Flash Setup vendor command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t FLASH_Setup(const uint8_t* request, uint8_t* response) {
+    uint32_t dhcsr = 0U;
+    uint8_t ack;
+
+    memset(&flash, 0, sizeof(flash));
+    flash.index = request[1];
+    flash.program_page = flash_get32(&request[2]);
+    flash.breakpoint = flash_get32(&request[6]);
+    flash.stack = flash_get32(&request[10]);
+    flash.static_base = flash_get32(&request[14]);
+    flash.buffer[0] = flash_get32(&request[18]);
+    flash.buffer[1] = flash_get32(&request[22]);
+    flash.page_size = flash_get32(&request[26]);
+
+    response[0] = request[0];
+    response[1] = DAP_ERROR;
+    flash.status = DAP_ERROR;
+
+    // Pages are a power of two, and the buffers must take whole words
+    if ((flash.page_size < 4U) || ((flash.page_size & (flash.page_size - 1U)) != 0U) ||
+        (((flash.buffer[0] | flash.buffer[1]) & 3U) != 0U)) {
+        return ((FLASH_SETUP_SIZE << 16) | 2U);
+    }
+
+    ack = MEM_GetCsw(flash.index, 2U, &flash.csw);
+    if (ack == DAP_TRANSFER_OK) {
+        ack = flash_read(FLASH_DHCSR, false, &dhcsr);
+    }
+    if (ack != DAP_TRANSFER_OK) {
+        flash.status = ack;
+        response[1] = ack;
+    } else if ((dhcsr & FLASH_DHCSR_S_HALT) != 0U) {
+        flash.ready = true;
+        flash.status = DAP_TRANSFER_OK;
+        response[1] = DAP_TRANSFER_OK;
+    }
+    return ((FLASH_SETUP_SIZE << 16) | 2U);
+}
+
+// Process Flash Program vendor command and prepare response
+//   request:   pointer to request data
+//   response:  pointer to response data
+//   resumable: zero when nested in DAP_ExecuteCommands or DAP_QueueCommands,
+//              which can't leave waiting for the algorithm to FLASH_Next, so
+//              the request is refused rather than waiting for up to
+//              FLASH_TIMEOUT_MS with the watchdog unfed
+//   return:    number of bytes in response (lower 16 bits)
+//              number of bytes in request (upper 16 bits)
+uint32_t FLASH_Program(const uint8_t* request, uint8_t* response, uint32_t resumable) {
+    uint32_t addr = flash_get32(&request[1]);
+    uint32_t len = (uint32_t)request[5] | ((uint32_t)request[6] << 8);
+
+    if ((((addr | len) & 3U) != 0U) || (resumable == 0U)) {
+        return flash_reject(request, response, 7U + len);
+    }
+
+    flash.data = &request[7];
+    flash.addr = addr;
+    flash.len = len;
+    flash.flush = false;
+    return flash_run(request, response, 7U + len);
+}
+
+// Process Flash Finish vendor command and prepare response
+//   request:   pointer to request data
+//   response:  pointer to response data
+//   resumable: zero when nested, as for FLASH_Program
+//   return:    number of bytes in response (lower 16 bits)
+//              number of bytes in request (upper 16 bits)
+uint32_t FLASH_Finish(const uint8_t* request, uint8_t* response, uint32_t resumable) {
+    if (resumable == 0U) {
+        return flash_reject(request, response, 1U);
+    }
+
+    flash.len = 0U;
+    flash.flush = true;
+    return flash_run(request, response, 1U);
+}
+
+// Carry on with a Flash Program or Flash Finish request, and fill in the
+// response once it's done
+//   response: pointer to response data
+//   return:   non-zero while still waiting for the algorithm
+uint32_t FLASH_Next(uint8_t* response) {
+    if (flash.pending) {
+        flash.pending = flash_step();
+        if (flash.pending) {
+            return 1U;
+        }
+    }
+
+    // Status, R0 of the failed call and the address of its page, or the
+    // address the next data is expected at
+    response[1] = (flash.status != 0U) ? flash.status : DAP_ERROR;
+    flash_put32(&response[2], flash.result);
+    flash_put32(&response[6], flash.ready ? (flash.fill_addr + flash.fill_len) : flash.busy_addr);
+    return 0U;
+}
+
+// Non-zero while a Flash request is waiting for the algorithm
+uint32_t FLASH_Pending(void) {
+    return flash.pending ? 1U : 0U;
+}
+
+// Stop working on the current Flash request
+void FLASH_Cancel(void) {
+    flash.pending = false;
+    flash.len = 0U;
+}
+
+#endif
@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2026, Devan Lai
+ *
+ * Permission to use, copy, modify, and/or distribute this software
+ * for any purpose with or without fee is hereby granted, provided
+ * that the above copyright notice and this permission notice
+ * appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdint.h>
+
+#include "DAP/CMSIS_DAP_hal.h"
+#include "DAP/CMSIS_DAP.h"
+
+#if (DAP_SWD_GANG != 0)
+
+/*
+ * Gang programming: the same SWD transfers sent to several identical
+ * targets at once. The targets share SWCLK and each has its own SWDIO pin,
+ * so the request and write data go out to all of them with one port write
+ * per bit, and their ACKs and read data come back with one port read per
+ * bit and are checked target by target.
+ *
+ * A target that answers anything but OK drops out for the rest of the
+ * command, and sees idle cycles while the others carry on. WAITs are
+ * retried for just the targets that sent them.
+ */
+
+#define GANG_ALL_TARGETS    ((1U << SWD_GANG_COUNT) - 1U)
+
+/// SWDIO pin of each target: target 0 is on the probe's own SWDIO pin, the
+/// others follow in pin order
+static uint32_t gang_pin[SWD_GANG_COUNT];
+
+static uint32_t gang_get32(const uint8_t* buf) {
+    return ((uint32_t)buf[0] <<  0) |
+           ((uint32_t)buf[1] <<  8) |
+           ((uint32_t)buf[2] << 16) |
+           ((uint32_t)buf[3] << 24);
+}
+
+static void gang_put32(uint8_t* buf, uint32_t value) {
+    buf[0] = (uint8_t)(value >>  0);
+    buf[1] = (uint8_t)(value >>  8);
+    buf[2] = (uint8_t)(value >> 16);
+    buf[3] = (uint8_t)(value >> 24);
+}
+
+// Map a mask of targets to their SWDIO pins
+static uint32_t gang_pins(uint32_t targets) {
+    uint32_t pins = 0U;
+    uint32_t t;
+
+    if (gang_pin[0] == 0U) {
+        uint32_t rest = SWD_GANG_SWDIO_PINS & ~SWDIO_GPIO_PIN;
+        gang_pin[0] = SWDIO_GPIO_PIN;
+        for (t = 1U; t < SWD_GANG_COUNT; t++) {
+            gang_pin[t] = rest & (~rest + 1U);
+            rest &= rest - 1U;
+        }
+    }
+
+    for (t = 0U; t < SWD_GANG_COUNT; t++) {
+        if (targets & (1U << t)) {
+            pins |= gang_pin[t];
+        }
+    }
+    return pins;
+}
+
+static void gang_delay(void) {
+    if (DAP_Data.fast_clock) {
+        PIN_DELAY_FAST();
+    } else {
+        PIN_DELAY_SLOW(DAP_Data.clock_delay);
+    }
+}
+
+// Clock out a bit that is high on the pins in ones and low on the others
+static void gang_write_bit(uint32_t ones) {
+    PIN_SWD_GANG_CLR_OUT(ones);
+    gang_delay();
+    PIN_SWCLK_TCK_SET();
+    gang_delay();
+}
+
+// Clock in a bit from every pin; the pins that are outputs are driven low
+static uint32_t gang_read_bit(void) {
+    uint32_t in;
+
+    PIN_SWD_GANG_CLR_OUT(0U);
+    gang_delay();
+    in = PIN_SWD_GANG_IN();
+    PIN_SWCLK_TCK_SET();
+    gang_delay();
+    return in;
+}
+
+// SWD transfer with several targets at once
+//   targets: mask of targets to transfer with
+//   request: A[3:2] RnW APnDP
+//   wdata:   data to write to every target
+//   rdata:   data read from each target that answered OK
+//   ack:     ACK[2:0] from each target in targets
+//   return:  mask of targets that answered OK
+static uint32_t gang_transfer(uint32_t targets, uint32_t request, uint32_t wdata,
+                              uint32_t* rdata, uint8_t* ack) {
+    uint32_t pins = gang_pins(targets);
+    uint32_t turnaround = DAP_Data.swd_conf.turnaround;
+    uint8_t parity[SWD_GANG_COUNT];
+    uint32_t ok = 0U;
+    uint32_t ok_pins;
+    uint32_t header;
+    uint32_t bit;
+    uint32_t in;
+    uint32_t n;
+    uint32_t t;
+
+    /* Packet Request: Start, APnDP, RnW, A[3:2], Parity, Stop, Park */
+    header = 0x81U | ((request & 0x0FU) << 1) | (((0x6996U >> (request & 0x0FU)) & 1U) << 5);
+    for (n = 8U; n; n--) {
+        gang_write_bit((header & 1U) ? pins : 0U);
+        header >>= 1;
+    }
+
+    /* Turnaround */
+    PIN_SWD_GANG_OUT_DISABLE(pins);
+    for (n = turnaround; n; n--) {
+        (void)gang_read_bit();
+    }
+
+    /* Acknowledge response */
+    for (t = 0U; t < SWD_GANG_COUNT; t++) {
+        ack[t] = (targets & (1U << t)) ? 0U : ack[t];
+        parity[t] = 0U;
+    }
+    for (n = 0U; n < 3U; n++) {
+        in = gang_read_bit();
+        for (t = 0U; t < SWD_GANG_COUNT; t++) {
+            if ((targets & (1U << t)) && (in & gang_pin[t])) {
+                ack[t] |= (uint8_t)(1U << n);
+            }
+        }
+    }
+    for (t = 0U; t < SWD_GANG_COUNT; t++) {
+        if ((targets & (1U << t)) && (ack[t] == DAP_TRANSFER_OK)) {
+            ok |= 1U << t;
+        }
+    }
+    ok_pins = gang_pins(ok);
+
+    if (ok && (request & DAP_TRANSFER_RnW)) {
+        /* Read RDATA[0:31] and Parity. The targets that didn't answer OK
+           have let go of SWDIO after the turnaround, and get idle cycles. */
+        for (t = 0U; t < SWD_GANG_COUNT; t++) {
+            if (ok & (1U << t)) {
+                rdata[t] = 0U;
+            }
+        }
+        for (n = 0U; n < 33U; n++) {
+            if (n == turnaround) {
+                PIN_SWD_GANG_OUT_ENABLE(pins & ~ok_pins);
+            }
+            in = gang_read_bit();
+            for (t = 0U; t < SWD_GANG_COUNT; t++) {
+                if (ok & (1U << t)) {
+                    bit = (in & gang_pin[t]) ? 1U : 0U;
+                    if (n < 32U) {
+                        rdata[t] |= bit << n;
+                    }
+                    parity[t] ^= (uint8_t)bit;
+                }
+            }
+        }
+        for (t = 0U; t < SWD_GANG_COUNT; t++) {
+            if ((ok & (1U << t)) && parity[t]) {
+                ack[t] = DAP_TRANSFER_ERROR;
+                ok &= ~(1U << t);
+            }
+        }
+        /* Turnaround */
+        for (n = turnaround; n; n--) {
+            (void)gang_read_bit();
+        }
+        PIN_SWD_GANG_OUT_ENABLE(ok_pins);
+    } else {
+        /* Turnaround */
+        for (n = turnaround; n; n--) {
+            (void)gang_read_bit();
+        }
+        PIN_SWD_GANG_OUT_ENABLE(pins);
+        if (ok) {
+            /* Write WDATA[0:31] and Parity to the targets that answered OK */
+            bit = 0U;
+            for (n = 0U; n < 32U; n++) {
+                bit ^= (wdata >> n) & 1U;
+                gang_write_bit(((wdata >> n) & 1U) ? ok_pins : 0U);
+            }
+            gang_write_bit(bit ? ok_pins : 0U);
+        }
+    }
+
+    /* Idle cycles */
+    for (n = DAP_Data.transfer.idle_cycles; n; n--) {
+        gang_write_bit(0U);
+    }
+    PIN_SWD_GANG_OUT(SWD_GANG_SWDIO_PINS);
+    return ok;
+}
+
+// Transfer, retrying WAITs with just the targets that sent them
+static uint32_t gang_transfer_retry(uint32_t targets, uint32_t request, uint32_t wdata,
+                                    uint32_t* rdata, uint8_t* ack) {
+    uint32_t retry = DAP_Data.transfer.retry_count;
+    uint32_t ok = 0U;
+    uint32_t t;
+
+    do {
+        ok |= gang_transfer(targets, request, wdata, rdata, ack);
+        for (t = 0U; t < SWD_GANG_COUNT; t++) {
+            if (ack[t] != DAP_TRANSFER_WAIT) {
+                targets &= ~(1U << t);
+            }
+        }
+    } while (targets && retry-- && !DAP_TransferAbort);
+
+    return ok;
+}
+
+// Drive the SWDIO pins of the rest of the gang, which PORT_SWD_SETUP leaves
+// floating for single-target SWD, high
+static void gang_enable(void) {
+    PIN_SWD_GANG_OUT(SWD_GANG_SWDIO_PINS);
+    PIN_SWD_GANG_OUT_ENABLE(SWD_GANG_SWDIO_PINS & ~SWDIO_GPIO_PIN);
+}
+
+// Process Gang Sequence vendor command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t GANG_Sequence(const uint8_t* request, uint8_t* response) {
+    uint32_t pins = gang_pins(request[1] & GANG_ALL_TARGETS);
+    uint32_t count = request[2];
+    const uint8_t* data = &request[3];
+    uint32_t n;
+
+    if (count == 0U) {
+        count = 256U;
+    }
+
+    response[0] = request[0];
+    if (DAP_Data.debug_port != DAP_PORT_SWD) {
+        response[1] = DAP_ERROR;
+    } else {
+        // The targets that aren't in the sequence see idle cycles
+        gang_enable();
+        for (n = 0U; n < count; n++) {
+            gang_write_bit((data[n >> 3] & (1U << (n & 7U))) ? pins : 0U);
+        }
+        PIN_SWD_GANG_OUT(SWD_GANG_SWDIO_PINS);
+        response[1] = DAP_OK;
+    }
+
+    return (((3U + ((count + 7U) >> 3)) << 16) | 2U);
+}
+
+// Process Gang Transfer vendor command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t GANG_Transfer(const uint8_t* request, uint8_t* response) {
+    uint32_t targets = request[1] & GANG_ALL_TARGETS;
+    uint32_t request_count = request[2];
+    uint32_t response_count = 0U;
+    uint32_t request_value;
+    uint32_t check_write = 0U;
+    uint32_t active = 0U;
+    uint32_t width = 0U;
+    uint32_t rdata[SWD_GANG_COUNT];
+    uint8_t ack[SWD_GANG_COUNT];
+    const uint8_t* req = &request[3];
+    uint8_t* resp;
+    uint8_t* p;
+    uint32_t t;
+
+    for (t = 0U; t < SWD_GANG_COUNT; t++) {
+        ack[t] = 0U;
+        rdata[t] = 0U;
+    }
+
+    // The ACKs come before the read data
+    for (t = 0U; t < SWD_GANG_COUNT; t++) {
+        if (targets & (1U << t)) {
+            width++;
+        }
+    }
+    resp = &response[4U + width];
+
+    if (DAP_Data.debug_port == DAP_PORT_SWD) {
+        gang_enable();
+        active = targets;
+    }
+
+    while (request_count && active && !DAP_TransferAbort) {
+        request_value = *req;
+        if (request_value & (DAP_TRANSFER_MATCH_VALUE | DAP_TRANSFER_MATCH_MASK | DAP_TRANSFER_TIMESTAMP)) {
+            // Not supported across targets
+            for (t = 0U; t < SWD_GANG_COUNT; t++) {
+                if (active & (1U << t)) {
+                    ack[t] = DAP_TRANSFER_ERROR;
+                }
+            }
+            active = 0U;
+            break;
+        }
+
+        if (request_value & DAP_TRANSFER_RnW) {
+            if ((resp + (4U * width)) > &response[DAP_GetPacketSize()]) {
+                break;
+            }
+            active = gang_transfer_retry(active, request_value, 0U, rdata, ack);
+            if (active && (request_value & DAP_TRANSFER_APnDP)) {
+                // AP reads are posted: pick the result up from RDBUFF
+                active = gang_transfer_retry(active, DP_RDBUFF | DAP_TRANSFER_RnW, 0U, rdata, ack);
+            }
+            for (t = 0U; t < SWD_GANG_COUNT; t++) {
+                if (targets & (1U << t)) {
+                    gang_put32(resp, (active & (1U << t)) ? rdata[t] : 0U);
+                    resp += 4;
+                }
+            }
+            req++;
+            check_write = 0U;
+        } else {
+            active = gang_transfer_retry(active, request_value, gang_get32(&req[1]), rdata, ack);
+            req += 5;
+            check_write = 1U;
+        }
+        request_count--;
+        response_count++;
+    }
+
+    // Skip over the requests that weren't processed
+    for (; request_count; request_count--) {
+        request_value = *req++;
+        if (!(request_value & DAP_TRANSFER_RnW) || (request_value & DAP_TRANSFER_MATCH_VALUE)) {
+            req += 4;
+        }
+    }
+
+    // Check that the last write went through
+    if (active && check_write) {
+        active = gang_transfer_retry(active, DP_RDBUFF | DAP_TRANSFER_RnW, 0U, rdata, ack);
+    }
+
+    response[0] = request[0];
+    response[1] = (uint8_t)response_count;
+    response[2] = (uint8_t)targets;
+    response[3] = (uint8_t)active;
+    p = &response[4];
+    for (t = 0U; t < SWD_GANG_COUNT; t++) {
+        if (targets & (1U << t)) {
+            *p++ = ack[t];
+        }
+    }
+
+    return (((uint32_t)(req - request) << 16) | (uint32_t)(resp - response));
+}
+
+#endif
@@ -58,18 +58,30 @@
 
 #if (DAP_JTAG != 0)
 
+#define JTAG_SELECT_NONE        0xFFU
+
+// SELECT value last written to the DP of device jtag_select_index
+static uint32_t jtag_select;
+static uint8_t  jtag_select_index = JTAG_SELECT_NONE;
+
 
 // Generate JTAG Sequence
 //   info:   sequence information
 //   tdi:    pointer to TDI generated data
 //   tdo:    pointer to TDO captured data
 //   return: none
+#ifdef RAMFUNC_JTAG_Sequence
+RAMFUNC(JTAG_Sequence)
+#endif
 void JTAG_Sequence (uint32_t info, const uint8_t *tdi, uint8_t *tdo) {
   uint32_t i_val;
   uint32_t o_val;
   uint32_t bit;
   uint32_t n, k;
 
+  // The host may be accessing a DP itself
+  jtag_select_index = JTAG_SELECT_NONE;
+
   n = info & JTAG_SEQUENCE_TCK;
   if (n == 0U) { n = 64U; }
 
@@ -99,8 +111,11 @@ void JTAG_Sequence (uint32_t info, const uint8_t *tdi, uint8_t *tdo) {
 // JTAG Set IR
 //   ir:     IR value
 //   return: none
-#define JTAG_IR_Function(speed) /**/                                            \
-static void JTAG_IR_##speed (uint32_t ir) {                                     \
+// With single set, the chain is assumed to be one device and the bypass
+// bits before and after it compile away.
+#define JTAG_IR_Function(name, single) /**/                                     \
+static void JTAG_IR_##name (uint32_t ir) {                                      \
+  uint32_t index = (single) ? 0U : DAP_Data.jtag_dev.index;                     \
   uint32_t n;                                                                   \
                                                                                 \
   PIN_TMS_SET();                                                                \
@@ -111,14 +126,15 @@ static void JTAG_IR_##speed (uint32_t ir) {
   JTAG_CYCLE_TCK();                         /* Shift-IR */                      \
                                                                                 \
   PIN_TDI_OUT(1U);                                                              \
-  for (n = DAP_Data.jtag_dev.ir_before[DAP_Data.jtag_dev.index]; n; n--) {      \
+  n = (single) ? 0U : DAP_Data.jtag_dev.ir_before[index];                       \
+  for (; n; n--) {                                                              \
     JTAG_CYCLE_TCK();                       /* Bypass before data */            \
   }                                                                             \
-  for (n = DAP_Data.jtag_dev.ir_length[DAP_Data.jtag_dev.index] - 1U; n; n--) { \
+  for (n = DAP_Data.jtag_dev.ir_length[index] - 1U; n; n--) {                   \
     JTAG_CYCLE_TDI(ir);                     /* Set IR bits (except last) */     \
     ir >>= 1;                                                                   \
   }                                                                             \
-  n = DAP_Data.jtag_dev.ir_after[DAP_Data.jtag_dev.index];                      \
+  n = (single) ? 0U : DAP_Data.jtag_dev.ir_after[index];                        \
   if (n) {                                                                      \
     JTAG_CYCLE_TDI(ir);                     /* Set last IR bit */               \
     PIN_TDI_OUT(1U);                                                            \
@@ -143,8 +159,11 @@ static void JTAG_IR_##speed (uint32_t ir) {
 //   request: A[3:2] RnW APnDP
 //   data:    DATA[31:0]
 //   return:  ACK[2:0]
-#define JTAG_TransferFunction(speed)        /**/                                \
-static uint8_t JTAG_Transfer##speed (uint32_t request, uint32_t *data) {        \
+// With single set, the chain is assumed to be one device and the bypass
+// bits before and after it compile away.
+#define JTAG_TransferFunction(name, single) /**/                                \
+static uint8_t JTAG_Transfer##name (uint32_t request, uint32_t *data) {         \
+  uint32_t index = (single) ? 0U : DAP_Data.jtag_dev.index;                     \
   uint32_t ack;                                                                 \
   uint32_t bit;                                                                 \
   uint32_t val;                                                                 \
@@ -156,7 +175,7 @@ static uint8_t JTAG_Transfer##speed (uint32_t request, uint32_t *data) {
   JTAG_CYCLE_TCK();                         /* Capture-DR */                    \
   JTAG_CYCLE_TCK();                         /* Shift-DR */                      \
                                                                                 \
-  for (n = DAP_Data.jtag_dev.index; n; n--) {                                   \
+  for (n = index; n; n--) {                                                     \
     JTAG_CYCLE_TCK();                       /* Bypass before data */            \
   }                                                                             \
                                                                                 \
@@ -182,7 +201,7 @@ static uint8_t JTAG_Transfer##speed (uint32_t request, uint32_t *data) {
       val  |= bit << 31;                                                        \
       val >>= 1;                                                                \
     }                                                                           \
-    n = DAP_Data.jtag_dev.count - DAP_Data.jtag_dev.index - 1U;                 \
+    n = (single) ? 0U : (DAP_Data.jtag_dev.count - index - 1U);                 \
     if (n) {                                                                    \
       JTAG_CYCLE_TDO(bit);                  /* Get D31 */                       \
       for (--n; n; n--) {                                                       \
@@ -203,7 +222,7 @@ static uint8_t JTAG_Transfer##speed (uint32_t request, uint32_t *data) {
       JTAG_CYCLE_TDI(val);                  /* Set D0..D30 */                   \
       val >>= 1;                                                                \
     }                                                                           \
-    n = DAP_Data.jtag_dev.count - DAP_Data.jtag_dev.index - 1u;                 \
+    n = (single) ? 0U : (DAP_Data.jtag_dev.count - index - 1U);                 \
     if (n) {                                                                    \
       JTAG_CYCLE_TDI(val);                  /* Set D31 */                       \
       for (--n; n; n--) {                                                       \
@@ -235,13 +254,29 @@ exit:
 
 #undef  PIN_DELAY
 #define PIN_DELAY() PIN_DELAY_FAST()
-JTAG_IR_Function(Fast);
-JTAG_TransferFunction(Fast);
+#ifdef RAMFUNC_JTAG_IR_Fast
+RAMFUNC(JTAG_IR_Fast)
+#endif
+JTAG_IR_Function(Fast, 0);
+#ifdef RAMFUNC_JTAG_IR_FastSingle
+RAMFUNC(JTAG_IR_FastSingle)
+#endif
+JTAG_IR_Function(FastSingle, 1);
+#ifdef RAMFUNC_JTAG_TransferFast
+RAMFUNC(JTAG_TransferFast)
+#endif
+JTAG_TransferFunction(Fast, 0);
+#ifdef RAMFUNC_JTAG_TransferFastSingle
+RAMFUNC(JTAG_TransferFastSingle)
+#endif
+JTAG_TransferFunction(FastSingle, 1);
 
 #undef  PIN_DELAY
 #define PIN_DELAY() PIN_DELAY_SLOW(DAP_Data.clock_delay)
-JTAG_IR_Function(Slow);
-JTAG_TransferFunction(Slow);
+JTAG_IR_Function(Slow, 0);
+JTAG_IR_Function(SlowSingle, 1);
+JTAG_TransferFunction(Slow, 0);
+JTAG_TransferFunction(SlowSingle, 1);
 
 
 // JTAG Read IDCODE register
@@ -328,7 +363,13 @@ void JTAG_WriteAbort (uint32_t data) {
 //   ir:     IR value
 //   return: none
 void JTAG_IR (uint32_t ir) {
-  if (DAP_Data.fast_clock) {
+  if (DAP_Data.jtag_dev.count == 1U) {
+    if (DAP_Data.fast_clock) {
+      JTAG_IR_FastSingle(ir);
+    } else {
+      JTAG_IR_SlowSingle(ir);
+    }
+  } else if (DAP_Data.fast_clock) {
     JTAG_IR_Fast(ir);
   } else {
     JTAG_IR_Slow(ir);
@@ -341,11 +382,35 @@ void JTAG_IR (uint32_t ir) {
 //   data:    DATA[31:0]
 //   return:  ACK[2:0]
 uint8_t  JTAG_Transfer(uint32_t request, uint32_t *data) {
-  if (DAP_Data.fast_clock) {
-    return JTAG_TransferFast(request, data);
+  uint8_t ack;
+
+  if (DAP_Data.jtag_dev.count == 1U) {
+    if (DAP_Data.fast_clock) {
+      ack = JTAG_TransferFastSingle(request, data);
+    } else {
+      ack = JTAG_TransferSlowSingle(request, data);
+    }
+  } else if (DAP_Data.fast_clock) {
+    ack = JTAG_TransferFast(request, data);
   } else {
-    return JTAG_TransferSlow(request, data);
+    ack = JTAG_TransferSlow(request, data);
   }
+
+  if ((request & 0x0FU) == DP_SELECT) {
+    jtag_select = *data;
+    jtag_select_index = (ack == DAP_TRANSFER_OK) ? DAP_Data.jtag_dev.index : JTAG_SELECT_NONE;
+  }
+  return ack;
+}
+
+
+// Read the SELECT value last written to the DP of a device
+//   index:  device index
+//   select: SELECT value
+//   return: 1 when the DP is known to hold it, 0 otherwise
+uint32_t JTAG_GetSelect (uint32_t index, uint32_t *select) {
+  *select = jtag_select;
+  return (jtag_select_index == index) ? 1U : 0U;
 }
 
 
@@ -0,0 +1,814 @@
+/*
+ * Copyright (c) 2026, Devan Lai
+ *
+ * Permission to use, copy, modify, and/or distribute this software
+ * for any purpose with or without fee is hereby granted, provided
+ * that the above copyright notice and this permission notice
+ * appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "DAP/CMSIS_DAP_hal.h"
+#include "DAP/CMSIS_DAP.h"
+
+#if (DAP_MEMORY != 0)
+
+/*
+ * Memory reads and writes through the currently selected MEM-AP. The probe
+ * sets up CSW and TAR itself and rewrites TAR at every 1 KiB boundary, where
+ * the auto-incremented address isn't guaranteed to carry over, so the host
+ * doesn't have to split accesses up. The register accesses go through the
+ * regular DAP_Transfer and DAP_TransferBlock commands, so WAIT retries and
+ * the SWD/JTAG differences are handled in one place.
+ *
+ * A read longer than one packet is answered with several response packets;
+ * the DAP app asks for the next one with MEM_ReadNext whenever it has a
+ * free buffer.
+ *
+ * A CRC of a memory range is worked out on the probe's CRC unit as the words
+ * are read, so that only the result goes back to the host. When it's sent as
+ * a request of its own, it's done one TAR block per MEM_Crc32Next call, so
+ * that the main loop keeps running during a long verify.
+ *
+ * A watched register, DHCSR by default, is read again every interval while
+ * the DAP app is idle, and changes of its masked value are counted until the
+ * host asks for them with a Watch Event command. The reads go through the
+ * MEM-AP that SELECT pointed at when the watch was set up. SELECT, CSW and
+ * TAR are put back afterwards, and a sticky error caused by the reads is
+ * cleared, so a host that caches them isn't upset by the reads in between
+ * its own requests.
+ */
+
+// MEM-AP registers, as DAP_Transfer request bits
+#define MEM_AP_CSW              (DAP_TRANSFER_APnDP)
+#define MEM_AP_TAR              (DAP_TRANSFER_APnDP | DAP_TRANSFER_A2)
+#define MEM_AP_DRW              (DAP_TRANSFER_APnDP | DAP_TRANSFER_A2 | DAP_TRANSFER_A3)
+
+// DP registers, as DAP_Transfer request bits
+#define MEM_DP_CTRL_STAT        (DAP_TRANSFER_A2)
+#define MEM_DP_SELECT           (DAP_TRANSFER_A3)
+
+/// SELECT.APSEL; the rest is left zero to reach bank 0 of the AP and DP
+#define MEM_SELECT_APSEL        0xFF000000U
+
+/// CTRL/STAT sticky flags. An AP access faults while STICKYERR or WDATAERR
+/// is set.
+#define MEM_CTRL_STICKY         0x00000032U
+#define MEM_CTRL_STICKYERR      0x00000020U
+#define MEM_CTRL_WDATAERR       0x00000080U
+
+/// ABORT.STKERRCLR | ABORT.WDERRCLR
+#define MEM_ABORT_ERRCLR        0x0000000CU
+
+#define MEM_CSW_SIZE            0x07U
+#define MEM_CSW_ADDRINC         0x30U
+#define MEM_CSW_ADDRINC_SINGLE  0x10U
+
+/// TAR only auto-increments within each 1 KiB block
+#define MEM_TAR_WRAP            0x400U
+
+/// Elements moved per DAP_TransferBlock for byte and halfword accesses
+#define MEM_CHUNK_WORDS         16U
+
+/// Command, status and byte count in front of the data
+#define MEM_HEADER_SIZE         4U
+
+/// Words read per DAP_TransferBlock into a buffer on the stack
+#define MEM_READ_CHUNK_WORDS     32U
+
+/// Register watched when the request gives address 0
+#define MEM_WATCH_DHCSR         0xE000EDF0U
+
+static struct {
+    uint8_t  id;            ///< Vendor command ID to answer with
+    uint8_t  index;         ///< DAP index of the JTAG device
+    uint8_t  size;          ///< log2 of the access size in bytes
+    bool     tar_valid;     ///< TAR holds the next address
+    uint32_t csw;
+    uint32_t addr;
+    uint32_t remaining;     ///< Bytes still to be sent
+} mem_read;
+
+static struct {
+    uint8_t  index;         ///< DAP index of the JTAG device
+    uint32_t csw;
+    uint32_t addr;
+    uint32_t remaining;     ///< Bytes still to be added to the CRC
+} mem_crc;
+
+static struct {
+    uint8_t  index;         ///< DAP index of the JTAG device
+    uint32_t ap;            ///< SELECT value for the MEM-AP
+    uint32_t addr;
+    uint32_t mask;
+    uint32_t interval;      ///< Timestamp ticks between reads, 0 when off
+    uint32_t next;          ///< Timestamp of the next read
+    uint32_t value;         ///< Value last read
+    uint8_t  ack;           ///< Response to the last read, 0 before the first
+    uint8_t  changes;       ///< Changes of the masked value since the host asked
+} mem_watch;
+
+static uint32_t mem_get32(const uint8_t* buf) {
+    return ((uint32_t)buf[0] <<  0) |
+           ((uint32_t)buf[1] <<  8) |
+           ((uint32_t)buf[2] << 16) |
+           ((uint32_t)buf[3] << 24);
+}
+
+static void mem_put32(uint8_t* buf, uint32_t value) {
+    buf[0] = (uint8_t)(value >>  0);
+    buf[1] = (uint8_t)(value >>  8);
+    buf[2] = (uint8_t)(value >> 16);
+    buf[3] = (uint8_t)(value >> 24);
+}
+
+// Read CSW, so that only its size and increment fields are changed
+uint8_t MEM_GetCsw(uint8_t index, uint32_t size, uint32_t* csw) {
+    const uint8_t request[4] = { ID_DAP_Transfer, index, 1U, MEM_AP_CSW | DAP_TRANSFER_RnW };
+    uint8_t response[7];
+
+    DAP_ProcessCommand(request, response);
+    if (response[2] != DAP_TRANSFER_OK) {
+        return response[2];
+    }
+
+    *csw = (mem_get32(&response[3]) & ~(MEM_CSW_SIZE | MEM_CSW_ADDRINC)) |
+           MEM_CSW_ADDRINC_SINGLE | size;
+    return DAP_TRANSFER_OK;
+}
+
+// Read CSW and TAR, to put them back after accesses in between the host's
+uint8_t MEM_GetCswTar(uint8_t index, uint32_t* csw, uint32_t* tar) {
+    const uint8_t request[5] = { ID_DAP_Transfer, index, 2U,
+                                 MEM_AP_CSW | DAP_TRANSFER_RnW, MEM_AP_TAR | DAP_TRANSFER_RnW };
+    uint8_t response[3U + (4U * 2U)];
+
+    DAP_ProcessCommand(request, response);
+    *csw = mem_get32(&response[3]);
+    *tar = mem_get32(&response[7]);
+    return response[2];
+}
+
+// Write CSW and TAR ahead of a run of DRW accesses
+uint8_t MEM_SetCswTar(uint8_t index, uint32_t csw, uint32_t addr) {
+    uint8_t request[13] = { ID_DAP_Transfer, index, 2U, MEM_AP_CSW };
+    uint8_t response[3];
+
+    mem_put32(&request[4], csw);
+    request[8] = MEM_AP_TAR;
+    mem_put32(&request[9], addr);
+
+    DAP_ProcessCommand(request, response);
+    return response[2];
+}
+
+// Read the SELECT value the host last wrote, if the DP is known to hold it
+static uint32_t mem_host_select(uint8_t index, uint32_t* select) {
+    (void)index;
+#if (DAP_SWD != 0)
+    if (DAP_Data.debug_port == DAP_PORT_SWD) {
+        return SWD_GetSelect(select);
+    }
+#endif
+#if (DAP_JTAG != 0)
+    if (DAP_Data.debug_port == DAP_PORT_JTAG) {
+        return JTAG_GetSelect(index, select);
+    }
+#endif
+    return 0U;
+}
+
+// Find the AP that the host's SELECT points at, for accesses made later in
+// between the host's requests
+uint8_t MEM_GetAp(uint8_t index, uint32_t* ap) {
+    uint32_t select;
+
+    if (!mem_host_select(index, &select)) {
+        return DAP_ERROR;
+    }
+    *ap = select & MEM_SELECT_APSEL;
+    return DAP_TRANSFER_OK;
+}
+
+// Clear a sticky error left by accesses of the probe's own
+//   ack:    result of those accesses
+//   return: ack, or FAULT if a JTAG-DP flagged an error
+static uint8_t mem_clear_sticky(uint8_t index, uint8_t ack) {
+    uint8_t response[3U + 4U];
+
+#if (DAP_JTAG != 0)
+    if (DAP_Data.debug_port == DAP_PORT_JTAG) {
+        uint8_t request[3U + 5U] = { ID_DAP_Transfer, index, 1U };
+        uint32_t ctrl;
+
+        // A JTAG-DP doesn't answer FAULT: look at CTRL/STAT instead, and
+        // write the flag back to clear it
+        request[3] = MEM_DP_CTRL_STAT | DAP_TRANSFER_RnW;
+        DAP_ProcessCommand(request, response);
+        ctrl = mem_get32(&response[3]);
+        if ((response[2] == DAP_TRANSFER_OK) && (ctrl & MEM_CTRL_STICKYERR)) {
+            request[3] = MEM_DP_CTRL_STAT;
+            mem_put32(&request[4], (ctrl & ~MEM_CTRL_STICKY) | MEM_CTRL_STICKYERR);
+            DAP_ProcessCommand(request, response);
+            if (ack == DAP_TRANSFER_OK) {
+                ack = DAP_TRANSFER_FAULT;
+            }
+        }
+        if ((response[2] != DAP_TRANSFER_OK) && (ack == DAP_TRANSFER_OK)) {
+            ack = response[2];
+        }
+        return ack;
+    }
+#endif
+    if (ack == DAP_TRANSFER_FAULT) {
+        const uint8_t abort[6] = { ID_DAP_WriteABORT, index, MEM_ABORT_ERRCLR, 0U, 0U, 0U };
+        DAP_ProcessCommand(abort, response);
+    }
+    return ack;
+}
+
+// Put the host's SELECT back if it was changed
+static uint8_t mem_put_select(uint8_t index, uint32_t select, uint8_t ack) {
+    uint8_t request[3U + 5U] = { ID_DAP_Transfer, index, 1U, MEM_DP_SELECT };
+    uint8_t response[3];
+    uint32_t current;
+
+    if (!mem_host_select(index, &current) || (current != select)) {
+        mem_put32(&request[4], select);
+        DAP_ProcessCommand(request, response);
+        if ((response[2] != DAP_TRANSFER_OK) && (ack == DAP_TRANSFER_OK)) {
+            ack = response[2];
+        }
+    }
+    return ack;
+}
+
+// Point SELECT at bank 0 of an AP for accesses in between the host's
+// requests, saving the host's SELECT, CSW and TAR. Nothing is touched while
+// a sticky error of the host's is pending. On success, MEM_ReleaseAp has to
+// follow.
+uint8_t MEM_ClaimAp(uint8_t index, uint32_t ap, MEM_Saved_t* saved) {
+    uint8_t request[3U + 5U + 1U] = { ID_DAP_Transfer, index, 0U };
+    uint8_t response[3U + 4U];
+    uint32_t n = 3U;
+    uint8_t ack;
+
+    if (!mem_host_select(index, &saved->select)) {
+        return DAP_ERROR;
+    }
+
+    if (saved->select != ap) {
+        request[n++] = MEM_DP_SELECT;
+        mem_put32(&request[n], ap);
+        n += 4U;
+        request[2]++;
+    }
+    request[n] = MEM_DP_CTRL_STAT | DAP_TRANSFER_RnW;
+    request[2]++;
+
+    DAP_ProcessCommand(request, response);
+    ack = response[2];
+    if ((ack == DAP_TRANSFER_OK) &&
+        (mem_get32(&response[3]) & (MEM_CTRL_STICKYERR | MEM_CTRL_WDATAERR))) {
+        // Leave the host's error for the host to see
+        ack = DAP_TRANSFER_FAULT;
+    }
+    if (ack != DAP_TRANSFER_OK) {
+        return mem_put_select(index, saved->select, ack);
+    }
+
+    ack = MEM_GetCswTar(index, &saved->csw, &saved->tar);
+    if (ack != DAP_TRANSFER_OK) {
+        return mem_put_select(index, saved->select, mem_clear_sticky(index, ack));
+    }
+    return DAP_TRANSFER_OK;
+}
+
+// Clear a sticky error left by the accesses since MEM_ClaimAp, and put the
+// host's CSW, TAR and SELECT back
+//   ack:    result of those accesses
+//   return: ack, or the result of the clean up if that failed
+uint8_t MEM_ReleaseAp(uint8_t index, const MEM_Saved_t* saved, uint8_t ack) {
+    uint8_t result;
+
+    ack = mem_clear_sticky(index, ack);
+    result = mem_clear_sticky(index, MEM_SetCswTar(index, saved->csw, saved->tar));
+    if (ack == DAP_TRANSFER_OK) {
+        ack = result;
+    }
+    return mem_put_select(index, saved->select, ack);
+}
+
+// Read count words from DRW into data. The DAP_TransferBlock response header
+// lands in the four bytes before data.
+static uint8_t mem_read_words(uint8_t index, uint8_t* data, uint32_t count, uint32_t* done) {
+    const uint8_t request[5] = { ID_DAP_TransferBlock, index,
+                                 (uint8_t)(count >> 0), (uint8_t)(count >> 8),
+                                 MEM_AP_DRW | DAP_TRANSFER_RnW };
+    uint8_t* response = data - 4;
+
+    DAP_ProcessCommand(request, response);
+    *done = (uint32_t)response[1] | ((uint32_t)response[2] << 8);
+    return response[3];
+}
+
+// Fill a response with the next part of the read
+//   return: number of bytes in response
+static uint32_t mem_read_packet(uint8_t* response) {
+    uint8_t* data = &response[MEM_HEADER_SIZE];
+    uint32_t capacity = ((DAP_GetPacketSize() - MEM_HEADER_SIZE) >> mem_read.size) << mem_read.size;
+    uint32_t count = 0U;
+    uint8_t ack = DAP_TRANSFER_OK;
+
+    while ((mem_read.remaining != 0U) && (count < capacity)) {
+        // Stop at the end of the read, the packet or the TAR block
+        uint32_t len = MEM_TAR_WRAP - (mem_read.addr & (MEM_TAR_WRAP - 1U));
+        uint32_t done = 0U;
+        uint32_t i;
+
+        if (len > (capacity - count)) {
+            len = capacity - count;
+        }
+        if (len > mem_read.remaining) {
+            len = mem_read.remaining;
+        }
+
+        if (!mem_read.tar_valid) {
+            ack = MEM_SetCswTar(mem_read.index, mem_read.csw, mem_read.addr);
+            if (ack != DAP_TRANSFER_OK) {
+                break;
+            }
+            mem_read.tar_valid = true;
+        }
+
+        if (mem_read.size == 2U) {
+            // Words go straight into place, after saving what the block
+            // response header overwrites
+            uint8_t saved[4];
+            memcpy(saved, &data[count] - 4, sizeof(saved));
+            ack = mem_read_words(mem_read.index, &data[count], len >> 2, &done);
+            memcpy(&data[count] - 4, saved, sizeof(saved));
+        } else {
+            // Bytes and halfwords arrive in their lane of a full word
+            uint8_t block[4U + (4U * MEM_CHUNK_WORDS)];
+            uint32_t n = len >> mem_read.size;
+            if (n > MEM_CHUNK_WORDS) {
+                n = MEM_CHUNK_WORDS;
+            }
+            ack = mem_read_words(mem_read.index, &block[4], n, &done);
+            for (i = 0U; i < done; i++) {
+                uint32_t addr = mem_read.addr + (i << mem_read.size);
+                uint32_t value = mem_get32(&block[4U + (4U * i)]) >> (8U * (addr & 3U));
+                data[count + (i << mem_read.size)] = (uint8_t)value;
+                if (mem_read.size == 1U) {
+                    data[count + (i << mem_read.size) + 1U] = (uint8_t)(value >> 8);
+                }
+            }
+        }
+
+        done <<= mem_read.size;
+        count += done;
+        mem_read.addr += done;
+        mem_read.remaining -= done;
+        if ((mem_read.addr & (MEM_TAR_WRAP - 1U)) == 0U) {
+            mem_read.tar_valid = false;
+        }
+        if (ack != DAP_TRANSFER_OK) {
+            break;
+        }
+    }
+
+    // A failed access ends the read
+    if (ack != DAP_TRANSFER_OK) {
+        mem_read.remaining = 0U;
+    }
+
+    response[0] = mem_read.id;
+    response[1] = ack;
+    response[2] = (uint8_t)(count >> 0);
+    response[3] = (uint8_t)(count >> 8);
+    return (MEM_HEADER_SIZE + count);
+}
+
+// Check the access size and alignment of a request
+static bool mem_valid(uint8_t size, uint32_t addr, uint32_t len) {
+    uint32_t mask = (1U << size) - 1U;
+    if (size > 2U) {
+        return false;
+    }
+    return ((addr & mask) == 0U) && ((len & mask) == 0U);
+}
+
+// Process Memory Read vendor command and prepare the first response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t MEM_Read(const uint8_t* request, uint8_t* response) {
+    uint8_t size = request[2];
+    uint32_t addr = mem_get32(&request[3]);
+    uint32_t len = mem_get32(&request[7]);
+    uint8_t ack;
+
+    mem_read.id = request[0];
+    mem_read.remaining = 0U;
+
+    if (!mem_valid(size, addr, len)) {
+        response[0] = request[0];
+        response[1] = DAP_ERROR;
+        response[2] = 0U;
+        response[3] = 0U;
+        return ((11U << 16) | MEM_HEADER_SIZE);
+    }
+
+    ack = MEM_GetCsw(request[1], size, &mem_read.csw);
+    if (ack != DAP_TRANSFER_OK) {
+        response[0] = request[0];
+        response[1] = ack;
+        response[2] = 0U;
+        response[3] = 0U;
+        return ((11U << 16) | MEM_HEADER_SIZE);
+    }
+
+    mem_read.index = request[1];
+    mem_read.size = size;
+    mem_read.tar_valid = false;
+    mem_read.addr = addr;
+    mem_read.remaining = len;
+    return ((11U << 16) | mem_read_packet(response));
+}
+
+// Number of bytes a read still has to send
+uint32_t MEM_ReadPending(void) {
+    return mem_read.remaining;
+}
+
+// Prepare the next response packet of a read
+//   response: pointer to response data
+//   return:   number of bytes in response
+uint32_t MEM_ReadNext(uint8_t* response) {
+    return mem_read_packet(response);
+}
+
+// Drop the rest of a read
+void MEM_ReadCancel(void) {
+    mem_read.remaining = 0U;
+}
+
+// Process Memory Write vendor command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t MEM_Write(const uint8_t* request, uint8_t* response) {
+    uint8_t size = request[2];
+    uint32_t addr = mem_get32(&request[3]);
+    uint32_t len = (uint32_t)request[7] | ((uint32_t)request[8] << 8);
+    uint32_t count = 0U;
+    uint8_t ack;
+
+    if (!mem_valid(size, addr, len) || (len > (DAP_GetPacketSize() - 9U))) {
+        response[0] = request[0];
+        response[1] = DAP_ERROR;
+        response[2] = 0U;
+        response[3] = 0U;
+        return ((9U << 16) | MEM_HEADER_SIZE);
+    }
+
+    ack = MEM_WriteBlock(request[1], size, addr, &request[9], len, &count);
+
+    response[0] = request[0];
+    response[1] = ack;
+    response[2] = (uint8_t)(count >> 0);
+    response[3] = (uint8_t)(count >> 8);
+    return (((9U + len) << 16) | MEM_HEADER_SIZE);
+}
+
+// Write an aligned block of data to target memory
+//   index: DAP index of the JTAG device
+//   size:  log2 of the access size in bytes
+//   count: number of bytes written
+//   return: acknowledge of the last transfer
+uint8_t MEM_WriteBlock(uint8_t index, uint32_t size, uint32_t addr,
+                       const uint8_t* data, uint32_t len, uint32_t* count) {
+    uint32_t written = 0U;
+    uint32_t csw = 0U;
+    uint8_t ack;
+
+    ack = MEM_GetCsw(index, size, &csw);
+    while ((ack == DAP_TRANSFER_OK) && (written < len)) {
+        uint8_t block[5U + (4U * MEM_CHUNK_WORDS)];
+        uint8_t result[4];
+        uint32_t n = MEM_TAR_WRAP - (addr & (MEM_TAR_WRAP - 1U));
+        uint32_t i;
+
+        if ((written == 0U) || ((addr & (MEM_TAR_WRAP - 1U)) == 0U)) {
+            ack = MEM_SetCswTar(index, csw, addr);
+            if (ack != DAP_TRANSFER_OK) {
+                break;
+            }
+        }
+
+        // Stop at the end of the data, the chunk or the TAR block
+        if (n > (len - written)) {
+            n = len - written;
+        }
+        n >>= size;
+        if (n > MEM_CHUNK_WORDS) {
+            n = MEM_CHUNK_WORDS;
+        }
+
+        block[0] = ID_DAP_TransferBlock;
+        block[1] = index;
+        block[2] = (uint8_t)n;
+        block[3] = 0U;
+        block[4] = MEM_AP_DRW;
+        for (i = 0U; i < n; i++) {
+            // Bytes and halfwords go in their lane of the data bus
+            uint32_t offset = written + (i << size);
+            uint32_t value;
+            if (size == 2U) {
+                value = mem_get32(&data[offset]);
+            } else if (size == 1U) {
+                value = (uint32_t)data[offset] | ((uint32_t)data[offset + 1U] << 8);
+            } else {
+                value = data[offset];
+            }
+            mem_put32(&block[5U + (4U * i)], value << (8U * ((addr + (i << size)) & 3U)));
+        }
+
+        DAP_ProcessCommand(block, result);
+        ack = result[3];
+        n = ((uint32_t)result[1] | ((uint32_t)result[2] << 8)) << size;
+        written += n;
+        addr += n;
+    }
+
+    *count = written;
+    return ack;
+}
+
+// Read a word-aligned block of target memory
+//   index:  DAP index of the JTAG device
+//   len:    number of bytes, a multiple of 4
+//   return: acknowledge of the last transfer
+uint8_t MEM_ReadBlock(uint8_t index, uint32_t addr, uint8_t* data, uint32_t len) {
+    uint8_t block[4U + (4U * MEM_READ_CHUNK_WORDS)];
+    uint32_t csw = 0U;
+    uint32_t count = 0U;
+    uint8_t ack;
+
+    ack = MEM_GetCsw(index, 2U, &csw);
+    while ((ack == DAP_TRANSFER_OK) && (count < len)) {
+        uint32_t n = MEM_TAR_WRAP - (addr & (MEM_TAR_WRAP - 1U));
+        uint32_t done = 0U;
+
+        if ((count == 0U) || ((addr & (MEM_TAR_WRAP - 1U)) == 0U)) {
+            ack = MEM_SetCswTar(index, csw, addr);
+            if (ack != DAP_TRANSFER_OK) {
+                break;
+            }
+        }
+
+        // Stop at the end of the data, the chunk or the TAR block
+        if (n > (len - count)) {
+            n = len - count;
+        }
+        n >>= 2;
+        if (n > MEM_READ_CHUNK_WORDS) {
+            n = MEM_READ_CHUNK_WORDS;
+        }
+
+        ack = mem_read_words(index, &block[4], n, &done);
+        memcpy(&data[count], &block[4], done << 2);
+        count += done << 2;
+        addr += done << 2;
+    }
+
+    return ack;
+}
+
+// Add the next TAR block of the range to the CRC, and finish the response
+// once the range is done or an access fails
+//   response: pointer to response data
+//   return:   number of bytes left in the range
+uint32_t MEM_Crc32Next(uint8_t* response) {
+    uint8_t block[4U + (4U * MEM_READ_CHUNK_WORDS)];
+    uint32_t len = MEM_TAR_WRAP - (mem_crc.addr & (MEM_TAR_WRAP - 1U));
+    uint8_t ack;
+
+    if (len > mem_crc.remaining) {
+        len = mem_crc.remaining;
+    }
+
+    ack = MEM_SetCswTar(mem_crc.index, mem_crc.csw, mem_crc.addr);
+    while ((ack == DAP_TRANSFER_OK) && (len != 0U)) {
+        uint32_t n = len >> 2;
+        uint32_t done = 0U;
+        uint32_t i;
+
+        if (n > MEM_READ_CHUNK_WORDS) {
+            n = MEM_READ_CHUNK_WORDS;
+        }
+        ack = mem_read_words(mem_crc.index, &block[4], n, &done);
+        for (i = 0U; i < done; i++) {
+            CRC32_ADD(mem_get32(&block[4U + (4U * i)]));
+        }
+
+        done <<= 2;
+        len -= done;
+        mem_crc.addr += done;
+        mem_crc.remaining -= done;
+    }
+
+    if ((ack != DAP_TRANSFER_OK) || (mem_crc.remaining == 0U)) {
+        mem_crc.remaining = 0U;
+        response[1] = ack;
+        mem_put32(&response[2], CRC32_GET());
+    }
+
+    return mem_crc.remaining;
+}
+
+// Process Memory CRC32 vendor command and prepare response. The CRC is
+// CRC-32/MPEG-2 (polynomial 0x04C11DB7, initial value 0xFFFFFFFF, no
+// reflection, no final XOR) over each little-endian word fed in MSB first.
+// It differs from the zlib CRC-32, which reflects and inverts.
+//   request:   pointer to request data
+//   response:  pointer to response data
+//   resumable: leave all but the first block to MEM_Crc32Next; otherwise
+//              the range must fit in one block
+//   return:    number of bytes in response (lower 16 bits)
+//              number of bytes in request (upper 16 bits)
+uint32_t MEM_Crc32(const uint8_t* request, uint8_t* response, uint32_t resumable) {
+    uint32_t addr = mem_get32(&request[2]);
+    uint32_t len = mem_get32(&request[6]);
+    uint8_t ack;
+
+    mem_crc.remaining = 0U;
+    response[0] = request[0];
+    response[1] = DAP_ERROR;
+    mem_put32(&response[2], 0U);
+
+    if (!mem_valid(2U, addr, len)) {
+        return ((10U << 16) | 6U);
+    }
+
+    // Nested in DAP_ExecuteCommands or DAP_QueueCommands, the rest of a long
+    // range couldn't be left for later, and working through it in one go
+    // could starve the watchdog
+    if ((resumable == 0U) && (len > (MEM_TAR_WRAP - (addr & (MEM_TAR_WRAP - 1U))))) {
+        return ((10U << 16) | 6U);
+    }
+
+    ack = MEM_GetCsw(request[1], 2U, &mem_crc.csw);
+    if (ack != DAP_TRANSFER_OK) {
+        response[1] = ack;
+        return ((10U << 16) | 6U);
+    }
+
+    CRC32_RESET();
+    mem_crc.index = request[1];
+    mem_crc.addr = addr;
+    mem_crc.remaining = len;
+    if (len == 0U) {
+        response[1] = DAP_TRANSFER_OK;
+        mem_put32(&response[2], CRC32_GET());
+    } else {
+        MEM_Crc32Next(response);
+    }
+
+    return ((10U << 16) | 6U);
+}
+
+// Number of bytes a CRC still has to add
+uint32_t MEM_Crc32Pending(void) {
+    return mem_crc.remaining;
+}
+
+// Drop the rest of a CRC
+void MEM_Crc32Cancel(void) {
+    mem_crc.remaining = 0U;
+}
+
+// Read the watched register, leaving SELECT, CSW and TAR as they were
+static uint8_t mem_watch_read(uint32_t* value) {
+    uint8_t request[3U + (5U * 2U) + 1U] = { ID_DAP_Transfer, mem_watch.index, 3U };
+    uint8_t response[3U + 4U];
+    MEM_Saved_t saved;
+    uint8_t ack;
+
+    ack = MEM_ClaimAp(mem_watch.index, mem_watch.ap, &saved);
+    if (ack != DAP_TRANSFER_OK) {
+        return ack;
+    }
+
+    request[3] = MEM_AP_CSW;
+    mem_put32(&request[4], (saved.csw & ~(MEM_CSW_SIZE | MEM_CSW_ADDRINC)) | 2U);
+    request[8] = MEM_AP_TAR;
+    mem_put32(&request[9], mem_watch.addr);
+    request[13] = MEM_AP_DRW | DAP_TRANSFER_RnW;
+
+    DAP_ProcessCommand(request, response);
+    *value = mem_get32(&response[3]);
+    return MEM_ReleaseAp(mem_watch.index, &saved, response[2]);
+}
+
+// Process Watch vendor command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t MEM_Watch(const uint8_t* request, uint8_t* response) {
+    uint32_t interval_ms = (uint32_t)request[10] | ((uint32_t)request[11] << 8);
+    uint32_t value = 0U;
+    uint8_t ack;
+
+    mem_watch.index = request[1];
+    mem_watch.addr = mem_get32(&request[2]);
+    mem_watch.mask = mem_get32(&request[6]);
+    mem_watch.interval = 0U;
+    mem_watch.changes = 0U;
+    if (mem_watch.addr == 0U) {
+        mem_watch.addr = MEM_WATCH_DHCSR;
+    }
+
+    // Start from the current value, so that only changes are reported
+    ack = MEM_GetAp(mem_watch.index, &mem_watch.ap);
+    if (ack == DAP_TRANSFER_OK) {
+        ack = mem_watch_read(&value);
+    }
+    mem_watch.ack = ack;
+    mem_watch.value = value;
+    if (ack == DAP_TRANSFER_OK) {
+        mem_watch.interval = interval_ms * (TIMESTAMP_CLOCK / 1000U);
+        mem_watch.next = TIMESTAMP_GET() + mem_watch.interval;
+    }
+
+    response[0] = request[0];
+    response[1] = ack;
+    mem_put32(&response[2], value);
+    return ((12U << 16) | 6U);
+}
+
+// Whether the watched register is due to be read again
+uint32_t MEM_WatchDue(void) {
+    return ((mem_watch.interval != 0U) &&
+            ((int32_t)(TIMESTAMP_GET() - mem_watch.next) >= 0)) ? 1U : 0U;
+}
+
+// Read the watched register, and count a change of the masked bits. A
+// failed read stops the watch.
+void MEM_WatchPoll(void) {
+    uint32_t value = 0U;
+    uint8_t ack;
+
+    mem_watch.next = TIMESTAMP_GET() + mem_watch.interval;
+    ack = mem_watch_read(&value);
+    if (ack != DAP_TRANSFER_OK) {
+        mem_watch.interval = 0U;
+    } else if (((value ^ mem_watch.value) & mem_watch.mask) == 0U) {
+        return;
+    }
+
+    if (mem_watch.changes != 0xFFU) {
+        mem_watch.changes++;
+    }
+    mem_watch.ack = ack;
+    mem_watch.value = value;
+}
+
+// Process Watch Event vendor command: report what the watch has seen since
+// the last one, without touching the target
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t MEM_WatchEvent(const uint8_t* request, uint8_t* response) {
+    response[0] = request[0];
+    response[1] = mem_watch.ack;
+    response[2] = mem_watch.changes;
+    mem_put32(&response[3], mem_watch.value);
+    mem_watch.changes = 0U;
+    return ((1U << 16) | 7U);
+}
+
+// Stop watching
+void MEM_WatchCancel(void) {
+    mem_watch.interval = 0U;
+    mem_watch.ack = 0U;
+    mem_watch.changes = 0U;
+}
+
+#endif
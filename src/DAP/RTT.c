@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) 2026, Devan Lai
+ *
+ * Permission to use, copy, modify, and/or distribute this software
+ * for any purpose with or without fee is hereby granted, provided
+ * that the above copyright notice and this permission notice
+ * appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "DAP/CMSIS_DAP_hal.h"
+#include "DAP/CMSIS_DAP.h"
+#include "config.h"
+
+#if RTT_AVAILABLE
+
+#if (DAP_MEMORY == 0)
+#error "The RTT bridge reads the target through the memory engine: set DAP_MEMORY"
+#endif
+
+#include "USB/vcdc.h"
+
+/*
+ * Bridge between one SEGGER RTT channel and the virtual CDC port. The probe
+ * finds the RTT control block, either at the address the host gives or by
+ * scanning a range of target RAM for its ID, and then polls the channel's
+ * buffers whenever the DAP app is idle: bytes in the up buffer are sent out
+ * of the virtual CDC port, and bytes the host writes to the port go into
+ * the down buffer.
+ *
+ * Each poll moves at most RTT_CHUNK bytes each way through the MEM-AP that
+ * SELECT pointed at when the bridge was started, and leaves SELECT, CSW and
+ * TAR as it found them, so that it can slot in between the host's requests.
+ */
+
+/// Control block ID, including its terminating NUL
+#define RTT_ID                  "SEGGER RTT"
+#define RTT_ID_SIZE             11U
+
+/// Offsets into the control block
+#define RTT_CB_MAX_UP           16U
+#define RTT_CB_BUFFERS          24U
+
+/// Size of a buffer descriptor, and offsets of its fields
+#define RTT_BUFFER_SIZE         24U
+#define RTT_BUFFER_DATA         4U
+#define RTT_BUFFER_LENGTH       8U
+#define RTT_BUFFER_WROFF        12U
+#define RTT_BUFFER_RDOFF        16U
+
+/// Bytes scanned for the control block per RTT_Next call, read into the
+/// response buffer of the request
+#if (DAP_PACKET_SIZE < 256U)
+#define RTT_SCAN_CHUNK          DAP_PACKET_SIZE
+#else
+#define RTT_SCAN_CHUNK          256U
+#endif
+
+/// Bytes moved each way per poll
+#define RTT_CHUNK               64U
+
+static struct {
+    uint8_t  id;            ///< Vendor command ID to answer with
+    uint8_t  index;         ///< DAP index of the JTAG device
+    uint8_t  channel;
+    uint32_t ap;            ///< SELECT value for the MEM-AP
+    uint32_t cb;            ///< Control block address, 0 until found
+    uint32_t up;            ///< Address of the channel's up buffer descriptor
+    uint32_t down;          ///< Address of its down buffer descriptor
+    uint32_t scan_addr;
+    uint32_t scan_end;      ///< End of the range still to be scanned
+    uint32_t interval;      ///< Timestamp ticks between polls, 0 when off
+    uint32_t next;          ///< Timestamp of the next poll
+} rtt;
+
+static uint32_t rtt_get32(const uint8_t* buf) {
+    return ((uint32_t)buf[0] <<  0) |
+           ((uint32_t)buf[1] <<  8) |
+           ((uint32_t)buf[2] << 16) |
+           ((uint32_t)buf[3] << 24);
+}
+
+static void rtt_put32(uint8_t* buf, uint32_t value) {
+    buf[0] = (uint8_t)(value >>  0);
+    buf[1] = (uint8_t)(value >>  8);
+    buf[2] = (uint8_t)(value >> 16);
+    buf[3] = (uint8_t)(value >> 24);
+}
+
+// Read the descriptors of the channel's buffers from the control block
+static uint8_t rtt_attach(uint32_t cb) {
+    uint8_t header[RTT_CB_BUFFERS];
+    uint32_t max_up;
+    uint32_t max_down;
+    uint8_t ack;
+
+    ack = MEM_ReadBlock(rtt.index, cb, header, sizeof(header));
+    if (ack != DAP_TRANSFER_OK) {
+        return ack;
+    }
+
+    max_up = rtt_get32(&header[RTT_CB_MAX_UP]);
+    max_down = rtt_get32(&header[RTT_CB_MAX_UP + 4U]);
+    if ((memcmp(header, RTT_ID, RTT_ID_SIZE) != 0) ||
+        (rtt.channel >= max_up) || (rtt.channel >= max_down)) {
+        return DAP_ERROR;
+    }
+
+    rtt.cb = cb;
+    rtt.up = cb + RTT_CB_BUFFERS + (RTT_BUFFER_SIZE * rtt.channel);
+    rtt.down = cb + RTT_CB_BUFFERS + (RTT_BUFFER_SIZE * (max_up + rtt.channel));
+    rtt.next = TIMESTAMP_GET();
+    return DAP_TRANSFER_OK;
+}
+
+// Read a byte range that needn't be word-aligned
+static uint8_t rtt_read_bytes(uint32_t addr, uint8_t* data, uint32_t len) {
+    uint8_t block[RTT_CHUNK + 8U];
+    uint32_t offset = addr & 3U;
+    uint8_t ack;
+
+    ack = MEM_ReadBlock(rtt.index, addr - offset, block, (offset + len + 3U) & ~3U);
+    memcpy(data, &block[offset], len);
+    return ack;
+}
+
+static uint8_t rtt_write_word(uint32_t addr, uint32_t value) {
+    uint8_t data[4];
+    uint32_t count;
+
+    rtt_put32(data, value);
+    return MEM_WriteBlock(rtt.index, 2U, addr, data, sizeof(data), &count);
+}
+
+// Send what's in the up buffer out of the virtual CDC port
+static uint8_t rtt_poll_up(void) {
+    uint8_t desc[RTT_BUFFER_SIZE];
+    uint8_t data[RTT_CHUNK];
+    uint32_t buffer;
+    uint32_t size;
+    uint32_t wroff;
+    uint32_t rdoff;
+    uint32_t n;
+    uint8_t ack;
+
+    ack = MEM_ReadBlock(rtt.index, rtt.up, desc, sizeof(desc));
+    if (ack != DAP_TRANSFER_OK) {
+        return ack;
+    }
+    buffer = rtt_get32(&desc[RTT_BUFFER_DATA]);
+    size = rtt_get32(&desc[RTT_BUFFER_LENGTH]);
+    wroff = rtt_get32(&desc[RTT_BUFFER_WROFF]);
+    rdoff = rtt_get32(&desc[RTT_BUFFER_RDOFF]);
+    if ((wroff >= size) || (rdoff >= size) || (wroff == rdoff)) {
+        return DAP_TRANSFER_OK;
+    }
+
+    // Up to the write offset or the end of the buffer
+    n = ((wroff > rdoff) ? wroff : size) - rdoff;
+    if (n > RTT_CHUNK) {
+        n = RTT_CHUNK;
+    }
+    if (n > vcdc_send_buffer_space()) {
+        n = vcdc_send_buffer_space();
+    }
+    if (n == 0U) {
+        return DAP_TRANSFER_OK;
+    }
+
+    ack = rtt_read_bytes(buffer + rdoff, data, n);
+    if (ack != DAP_TRANSFER_OK) {
+        return ack;
+    }
+    vcdc_send_buffered(data, n);
+
+    rdoff += n;
+    if (rdoff == size) {
+        rdoff = 0U;
+    }
+    return rtt_write_word(rtt.up + RTT_BUFFER_RDOFF, rdoff);
+}
+
+// Pass what the host wrote to the virtual CDC port on to the down buffer
+static uint8_t rtt_poll_down(void) {
+    uint8_t desc[RTT_BUFFER_SIZE];
+    uint8_t data[RTT_CHUNK];
+    uint32_t buffer;
+    uint32_t size;
+    uint32_t wroff;
+    uint32_t rdoff;
+    uint32_t count;
+    uint32_t n;
+    uint8_t ack;
+
+    ack = MEM_ReadBlock(rtt.index, rtt.down, desc, sizeof(desc));
+    if (ack != DAP_TRANSFER_OK) {
+        return ack;
+    }
+    buffer = rtt_get32(&desc[RTT_BUFFER_DATA]);
+    size = rtt_get32(&desc[RTT_BUFFER_LENGTH]);
+    wroff = rtt_get32(&desc[RTT_BUFFER_WROFF]);
+    rdoff = rtt_get32(&desc[RTT_BUFFER_RDOFF]);
+    if ((wroff >= size) || (rdoff >= size)) {
+        return DAP_TRANSFER_OK;
+    }
+
+    // Up to the byte before the read offset or the end of the buffer
+    if (rdoff > wroff) {
+        n = rdoff - wroff - 1U;
+    } else {
+        n = size - wroff - ((rdoff == 0U) ? 1U : 0U);
+    }
+    if (n > RTT_CHUNK) {
+        n = RTT_CHUNK;
+    }
+    n = vcdc_recv_buffered(data, n);
+    if (n == 0U) {
+        return DAP_TRANSFER_OK;
+    }
+
+    ack = MEM_WriteBlock(rtt.index, 0U, buffer + wroff, data, n, &count);
+    if (ack != DAP_TRANSFER_OK) {
+        return ack;
+    }
+
+    wroff += n;
+    if (wroff == size) {
+        wroff = 0U;
+    }
+    return rtt_write_word(rtt.down + RTT_BUFFER_WROFF, wroff);
+}
+
+// Look for the control block in the next part of the range. The response
+// buffer holds the part being scanned until the answer is filled in.
+//   response: pointer to response data, DAP_PACKET_SIZE bytes
+//   return:   number of bytes left to scan
+uint32_t RTT_Next(uint8_t* response) {
+    uint8_t* block = response;
+    uint32_t len = rtt.scan_end - rtt.scan_addr;
+    uint32_t i;
+    uint8_t ack;
+
+    if (len > RTT_SCAN_CHUNK) {
+        len = RTT_SCAN_CHUNK;
+    }
+
+    ack = MEM_ReadBlock(rtt.index, rtt.scan_addr, block, len);
+    for (i = 0U; (ack == DAP_TRANSFER_OK) && ((i + RTT_ID_SIZE) <= len); i += 4U) {
+        if (memcmp(&block[i], RTT_ID, RTT_ID_SIZE) == 0) {
+            ack = rtt_attach(rtt.scan_addr + i);
+            if (ack == DAP_TRANSFER_OK) {
+                rtt.scan_end = rtt.scan_addr;
+                break;
+            }
+            ack = DAP_TRANSFER_OK;
+        }
+    }
+
+    if ((ack != DAP_TRANSFER_OK) || (rtt.cb != 0U) || (rtt.scan_addr + len >= rtt.scan_end)) {
+        // Found, failed, or the whole range has been scanned
+        rtt.scan_end = rtt.scan_addr;
+        if ((ack == DAP_TRANSFER_OK) && (rtt.cb == 0U)) {
+            ack = DAP_ERROR;
+        }
+        if (ack != DAP_TRANSFER_OK) {
+            rtt.interval = 0U;
+        }
+        response[0] = rtt.id;
+        response[1] = ack;
+        rtt_put32(&response[2], rtt.cb);
+        return 0U;
+    }
+
+    // Overlap the chunks so that an ID across the boundary isn't missed
+    rtt.scan_addr += len - ((RTT_ID_SIZE + 3U) & ~3U);
+    return rtt.scan_end - rtt.scan_addr;
+}
+
+// Process RTT vendor command and prepare response
+//   request:   pointer to request data
+//   response:  pointer to response data
+//   resumable: leave scanning to RTT_Next; otherwise only a control block
+//              at a given address can be used
+//   return:    number of bytes in response (lower 16 bits)
+//              number of bytes in request (upper 16 bits)
+uint32_t RTT_Start(const uint8_t* request, uint8_t* response, uint32_t resumable) {
+    uint32_t addr = rtt_get32(&request[3]);
+    uint32_t range = rtt_get32(&request[7]);
+    uint32_t interval_ms = (uint32_t)request[11] | ((uint32_t)request[12] << 8);
+    uint8_t ack;
+
+    memset(&rtt, 0, sizeof(rtt));
+    rtt.id = request[0];
+    rtt.index = request[1];
+    rtt.channel = request[2];
+    response[0] = request[0];
+    response[1] = DAP_TRANSFER_OK;
+    rtt_put32(&response[2], 0U);
+
+    if (interval_ms == 0U) {
+        return ((13U << 16) | 6U);
+    }
+    // Nested in DAP_ExecuteCommands or DAP_QueueCommands, a scan couldn't be
+    // left for later, and the response doesn't start a buffer that it could
+    // be read into
+    if (((addr & 3U) != 0U) || ((range & 3U) != 0U) ||
+        ((resumable == 0U) && (range != 0U))) {
+        response[1] = DAP_ERROR;
+        return ((13U << 16) | 6U);
+    }
+    ack = MEM_GetAp(rtt.index, &rtt.ap);
+    if (ack != DAP_TRANSFER_OK) {
+        response[1] = ack;
+        return ((13U << 16) | 6U);
+    }
+
+    rtt.interval = interval_ms * (TIMESTAMP_CLOCK / 1000U);
+    if (range == 0U) {
+        ack = rtt_attach(addr);
+        if (ack != DAP_TRANSFER_OK) {
+            rtt.interval = 0U;
+        }
+        response[1] = ack;
+        rtt_put32(&response[2], rtt.cb);
+    } else {
+        rtt.scan_addr = addr;
+        rtt.scan_end = addr + range;
+        RTT_Next(response);
+    }
+
+    return ((13U << 16) | 6U);
+}
+
+// Number of bytes still to be scanned for the control block
+uint32_t RTT_Pending(void) {
+    return rtt.scan_end - rtt.scan_addr;
+}
+
+// Whether the channel is due to be polled
+uint32_t RTT_Due(void) {
+    return ((rtt.cb != 0U) && (rtt.interval != 0U) &&
+            ((int32_t)(TIMESTAMP_GET() - rtt.next) >= 0)) ? 1U : 0U;
+}
+
+// Non-zero while the channel is being bridged to the virtual CDC port
+uint32_t RTT_Active(void) {
+    return ((rtt.interval != 0U) && (RTT_Pending() == 0U)) ? 1U : 0U;
+}
+
+// Move data each way between the channel and the virtual CDC port. A failed
+// access stops the bridge.
+void RTT_Poll(void) {
+    MEM_Saved_t saved;
+    uint8_t ack;
+
+    rtt.next = TIMESTAMP_GET() + rtt.interval;
+    ack = MEM_ClaimAp(rtt.index, rtt.ap, &saved);
+    if (ack == DAP_TRANSFER_OK) {
+        ack = rtt_poll_up();
+        if (ack == DAP_TRANSFER_OK) {
+            ack = rtt_poll_down();
+        }
+        ack = MEM_ReleaseAp(rtt.index, &saved, ack);
+    }
+    if (ack != DAP_TRANSFER_OK) {
+        rtt.interval = 0U;
+    }
+}
+
+// Stop bridging
+void RTT_Stop(void) {
+    rtt.interval = 0U;
+    rtt.scan_end = rtt.scan_addr;
+}
+
+#endif
@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2026, Devan Lai
+ *
+ * Permission to use, copy, modify, and/or distribute this software
+ * for any purpose with or without fee is hereby granted, provided
+ * that the above copyright notice and this permission notice
+ * appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <libopencm3/cm3/cortex.h>
+
+#include "DAP/CMSIS_DAP_hal.h"
+#include "DAP/CMSIS_DAP.h"
+#include "console.h"
+
+#if (SWO_UART != 0)
+
+/*
+ * SWO trace in UART (NRZ) mode is captured by the console USART. While the
+ * capture is set up, the RX pin is lent out by the USB-serial bridge and the
+ * console's circular RX DMA buffer doubles as the trace buffer, so that the
+ * trace costs no extra RAM.
+ */
+_Static_assert(CDC_AVAILABLE, "SWO capture borrows the console USART");
+_Static_assert(SWO_BUFFER_SIZE == CONSOLE_RX_BUFFER_SIZE,
+               "SWO trace is captured into the console RX buffer");
+
+// SWO Transport
+#define SWO_TRANSPORT_NONE      0U
+#define SWO_TRANSPORT_DATA      1U      ///< Read with DAP_SWO_Data
+#define SWO_TRANSPORT_STREAM    2U      ///< Sent on the bulk trace endpoint
+
+/// Trace bytes sent per packet on the trace endpoint.
+#define SWO_STREAM_PACKET_SIZE  64U
+
+static uint8_t  swo_transport = SWO_TRANSPORT_NONE;
+static uint8_t  swo_mode = DAP_SWO_OFF;
+static uint32_t swo_baudrate = 0U;
+static bool     swo_active = false;
+static bool     swo_claimed = false;    ///< Console RX is capturing for us
+static bool     swo_stream_zlp = false; ///< Last trace packet was full-sized
+
+static void swo_put32(uint8_t* buf, uint32_t value) {
+    buf[0] = (uint8_t)(value >>  0);
+    buf[1] = (uint8_t)(value >>  8);
+    buf[2] = (uint8_t)(value >> 16);
+    buf[3] = (uint8_t)(value >> 24);
+}
+
+static uint8_t swo_get_status(void) {
+    uint8_t status = swo_active ? DAP_SWO_CAPTURE_ACTIVE : 0U;
+    // Sticky until the next capture starts
+    if (swo_claimed && (console_recv_lost() != 0U)) {
+        status |= DAP_SWO_BUFFER_OVERRUN;
+    }
+    return status;
+}
+
+static uint32_t swo_get_count(void) {
+    return swo_claimed ? (uint32_t)console_recv_buffer_level() : 0U;
+}
+
+// Give the RX pin back to the USB-serial bridge
+static void swo_release(void) {
+    swo_active = false;
+    if (swo_claimed) {
+        swo_claimed = false;
+        console_release();
+    }
+}
+
+// Queue the next run of captured trace on the trace endpoint, if it is idle.
+// Called from the main loop, the RX DMA interrupt and the trace endpoint.
+void SWO_Process(void) {
+#if (SWO_STREAM != 0)
+    CM_ATOMIC_BLOCK() {
+        if ((swo_transport == SWO_TRANSPORT_STREAM) && swo_claimed) {
+            uint16_t len = 0U;
+            const uint8_t* data = console_recv_peek(&len);
+            if (len > SWO_STREAM_PACKET_SIZE) {
+                len = SWO_STREAM_PACKET_SIZE;
+            }
+
+            if (data != NULL) {
+                // The packet is copied to the USB peripheral when queued
+                if (SWO_QueueTransfer((uint8_t*)data, len)) {
+                    console_recv_skip(len);
+                    swo_stream_zlp = (len == SWO_STREAM_PACKET_SIZE);
+                }
+            } else if (swo_stream_zlp) {
+                // End the host's transfer once the trace goes quiet
+                if (SWO_QueueTransfer(NULL, 0U)) {
+                    swo_stream_zlp = false;
+                }
+            }
+        }
+    }
+#endif
+}
+
+// Whether captured trace is being sent on the trace endpoint
+uint32_t SWO_Streaming(void) {
+    return ((swo_transport == SWO_TRANSPORT_STREAM) && swo_active) ? 1U : 0U;
+}
+
+void SWO_TransferComplete(void) {
+    SWO_Process();
+}
+
+// Process SWO Transport command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t SWO_Transport(const uint8_t* request, uint8_t* response) {
+    uint8_t transport = request[0];
+    uint8_t result = DAP_ERROR;
+
+    if (!swo_active) {
+        if ((transport == SWO_TRANSPORT_NONE) || (transport == SWO_TRANSPORT_DATA) ||
+            ((SWO_STREAM != 0) && (transport == SWO_TRANSPORT_STREAM))) {
+            CM_ATOMIC_BLOCK() {
+                swo_transport = transport;
+                swo_stream_zlp = false;
+            }
+            result = DAP_OK;
+        }
+    }
+
+    response[0] = result;
+    return ((1U << 16) | 1U);
+}
+
+// Process SWO Mode command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t SWO_Mode(const uint8_t* request, uint8_t* response) {
+    uint8_t mode = request[0];
+    uint8_t result = DAP_OK;
+
+    CM_ATOMIC_BLOCK() {
+        swo_release();
+    }
+
+    if ((mode == DAP_SWO_OFF) || (mode == DAP_SWO_UART)) {
+        swo_mode = mode;
+    } else {
+        swo_mode = DAP_SWO_OFF;
+        result = DAP_ERROR;
+    }
+    swo_baudrate = 0U;
+
+    response[0] = result;
+    return ((1U << 16) | 1U);
+}
+
+// Process SWO Baudrate command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t SWO_Baudrate(const uint8_t* request, uint8_t* response) {
+    uint32_t baudrate = (uint32_t)(request[0] <<  0) |
+                        (uint32_t)(request[1] <<  8) |
+                        (uint32_t)(request[2] << 16) |
+                        (uint32_t)(request[3] << 24);
+
+    if (swo_active || (swo_mode != DAP_SWO_UART)) {
+        baudrate = 0U;
+    } else {
+        if (baudrate > SWO_UART_MAX_BAUDRATE) {
+            baudrate = SWO_UART_MAX_BAUDRATE;
+        }
+        swo_baudrate = baudrate;
+        // Report what the USART divider actually achieves
+        baudrate = console_actual_baudrate(baudrate);
+        if (baudrate == 0U) {
+            swo_baudrate = 0U;
+        }
+    }
+
+    swo_put32(response, baudrate);
+    return ((4U << 16) | 4U);
+}
+
+// Process SWO Control command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t SWO_Control(const uint8_t* request, uint8_t* response) {
+    bool active = (request[0] & DAP_SWO_CAPTURE_ACTIVE) != 0U;
+    uint8_t result = DAP_OK;
+
+    if (active && !swo_active) {
+        if ((swo_mode == DAP_SWO_UART) && (swo_baudrate != 0U)) {
+            CM_ATOMIC_BLOCK() {
+                // Starting over discards the old trace and overrun status
+                swo_stream_zlp = false;
+                swo_claimed = console_capture_start(swo_baudrate,
+                                                    (SWO_STREAM != 0) ? SWO_Process : NULL);
+                swo_active = swo_claimed;
+            }
+        }
+        // Fails while the USART is claimed for DAP UART commands
+        if (!swo_active) {
+            result = DAP_ERROR;
+        }
+    } else if (!active && swo_active) {
+        // Keep the captured trace readable until the mode changes
+        console_recv_enable(false);
+        swo_active = false;
+    }
+
+    response[0] = result;
+    return ((1U << 16) | 1U);
+}
+
+// Process SWO Status command and prepare response
+//   response: pointer to response data
+//   return:   number of bytes in response
+uint32_t SWO_Status(uint8_t* response) {
+    uint8_t status;
+    uint32_t count;
+
+    CM_ATOMIC_BLOCK() {
+        status = swo_get_status();
+        count = swo_get_count();
+    }
+
+    response[0] = status;
+    swo_put32(&response[1], count);
+    return (5U);
+}
+
+// Process SWO Extended Status command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t SWO_ExtendedStatus(const uint8_t* request, uint8_t* response) {
+    uint8_t cmd = request[0];
+    uint32_t num = 0U;
+
+    CM_ATOMIC_BLOCK() {
+        if ((cmd & 0x01U) != 0U) {
+            response[num] = swo_get_status();
+            num += 1U;
+        }
+        if ((cmd & 0x02U) != 0U) {
+            swo_put32(&response[num], swo_get_count());
+            num += 4U;
+        }
+        if ((cmd & 0x04U) != 0U) {
+            // Trace index counts every byte captured since the start
+            swo_put32(&response[num], swo_claimed ? console_recv_count() : 0U);
+            swo_put32(&response[num + 4U], TIMESTAMP_GET());
+            num += 8U;
+        }
+    }
+
+    return ((1U << 16) | num);
+}
+
+// Process SWO Data command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t SWO_Data(const uint8_t* request, uint8_t* response) {
+    uint16_t max_count = (uint16_t)(request[0] | (request[1] << 8));
+    uint16_t count = 0U;
+
+    // Leave room for the command, status and count bytes
+    uint16_t limit = DAP_GetPacketSize() - 4U;
+    if (max_count > limit) {
+        max_count = limit;
+    }
+
+    // Nothing else reads the buffer unless the trace is being streamed
+    uint8_t status = swo_get_status();
+    if ((swo_transport == SWO_TRANSPORT_DATA) && swo_claimed) {
+        while (count < max_count) {
+            uint16_t len = 0U;
+            const uint8_t* data = console_recv_peek(&len);
+            if (data == NULL) {
+                break;
+            }
+            if (len > (max_count - count)) {
+                len = max_count - count;
+            }
+            memcpy(&response[3U + count], data, len);
+            console_recv_skip(len);
+            count += len;
+        }
+    }
+
+    response[0] = status;
+    response[1] = (uint8_t)(count >> 0);
+    response[2] = (uint8_t)(count >> 8);
+    return ((2U << 16) | (3U + count));
+}
+
+#endif
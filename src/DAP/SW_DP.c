@@ -46,11 +46,148 @@
 #define PIN_DELAY() PIN_DELAY_SLOW(DAP_Data.clock_delay)
 
 
+#if (DAP_SWD != 0)
+
+// SELECT is remembered for this many targets on a multidrop bus, so that a
+// write of the value a target's DP already holds can be skipped. One more
+// entry follows the target that the host selected itself (or the only one).
+#if (DAP_SWD_MULTIDROP != 0)
+#define SWD_TARGET_COUNT        4U
+#else
+#define SWD_TARGET_COUNT        0U
+#endif
+#define SWD_TARGET_HOST         SWD_TARGET_COUNT
+
+#define SWD_WAIT_NONE           0xFFU
+
+static struct {
+  uint32_t targetsel;
+  uint32_t select;
+  uint8_t  known;                       // select holds the DP's SELECT
+} swd_target[SWD_TARGET_COUNT + 1U];
+
+static uint8_t  swd_target_index = SWD_TARGET_HOST; // Target currently selected
+#if (DAP_SWD_MULTIDROP != 0)
+static uint8_t  swd_target_next;        // Entry to reuse for a new target
+#endif
+static uint32_t swd_line_ones;          // Ones clocked out since the last zero
+static uint32_t swd_wait_request = SWD_WAIT_NONE; // Request that got the last WAIT
+static uint32_t swd_wait_run;           // WAIT responses to it in a row
+
+// WAIT, FAULT and protocol error responses to DP [0] and AP [1] accesses
+static uint32_t swd_ack_stats[2][3];
+
+// Forget the SELECT value of every target
+FLASHCALL
+static void SWD_ForgetSelect (void) {
+  uint32_t n;
+
+  for (n = 0U; n <= SWD_TARGET_COUNT; n++) {
+    swd_target[n].known = 0U;
+  }
+}
+
+// Count a response other than OK, and remember a WAIT so that the retry
+// idles first
+//   request: A[3:2] RnW APnDP
+//   ack:     ACK[2:0]
+FLASHCALL
+static void SWD_NotOK (uint32_t request, uint32_t ack) {
+  request &= 0x0FU;
+  if (ack == DAP_TRANSFER_WAIT) {
+    swd_ack_stats[request & DAP_TRANSFER_APnDP][0]++;
+    if (request != swd_wait_request) {
+      swd_wait_request = request;
+      swd_wait_run = 0U;
+    }
+    return;
+  }
+
+  swd_wait_request = SWD_WAIT_NONE;
+  if (ack == DAP_TRANSFER_FAULT) {
+    swd_ack_stats[request & DAP_TRANSFER_APnDP][1]++;
+  } else {
+    swd_ack_stats[request & DAP_TRANSFER_APnDP][2]++;
+  }
+}
+
+// Idle before retrying the request that got the last WAIT: wait_idle cycles
+// at first, doubled for each further WAIT in a row up to wait_idle_max, or
+// without a limit when that is zero. Nothing is clocked after the last
+// retry, and a request other than the one that got the WAIT starts over.
+FLASHCALL
+static void SWD_WaitIdle (void) {
+  uint32_t max = DAP_Data.swd_conf.wait_idle_max;
+  uint32_t n;
+
+  if (max == 0U) {
+    max = 0xFFFFU;
+  }
+  n = (uint32_t)DAP_Data.swd_conf.wait_idle << swd_wait_run;
+  if (n >= max) {
+    n = max;
+  } else if (n != 0U) {
+    swd_wait_run++;
+  }
+  if (n) {
+    PIN_SWDIO_OUT(0U);
+    for (; n; n--) {
+      SW_CLOCK_CYCLE();
+    }
+    PIN_SWDIO_OUT(1U);
+  }
+}
+
+// End a run of ones on SWDIO: after a line reset, DPBANKSEL is zero
+FLASHCALL
+static void SWD_EndOnes (void) {
+  uint32_t n;
+
+  if (swd_line_ones >= 50U) {
+    for (n = 0U; n <= SWD_TARGET_COUNT; n++) {
+      swd_target[n].select &= ~0x0FU;
+    }
+  }
+  swd_line_ones = 0U;
+}
+
+// Follow an SWJ sequence about to be clocked out on SWDIO. A line reset only
+// resets DPBANKSEL; anything more than line resets and idle cycles (a switch
+// sequence or dormant wakeup) leaves SELECT unknown. Kept out of
+// SWJ_Sequence so that the clock calibration times the bare sequence.
+//   count:  sequence bit count
+//   data:   pointer to sequence bit data
+//   return: none
+void SWD_TrackSequence (uint32_t count, const uint8_t *data) {
+  uint32_t idle = 0U;
+  uint32_t n;
+
+  for (n = 0U; n < count; n++) {
+    if (data[n >> 3] & (1U << (n & 7U))) {
+      if (idle) {
+        SWD_ForgetSelect();
+        swd_line_ones = 0U;
+        return;
+      }
+      swd_line_ones++;
+    } else {
+      SWD_EndOnes();
+      idle = 1U;
+    }
+  }
+}
+
+#endif
+
+
 // Generate SWJ Sequence
 //   count:  sequence bit count
 //   data:   pointer to sequence bit data
 //   return: none
 #if ((DAP_SWD != 0) || (DAP_JTAG != 0))
+#ifdef RAMFUNC_SWJ_Sequence
+RAMFUNC(SWJ_Sequence)
+#endif
 void SWJ_Sequence (uint32_t count, const uint8_t *data) {
   uint32_t val;
   uint32_t n;
@@ -81,11 +218,18 @@ void SWJ_Sequence (uint32_t count, const uint8_t *data) {
 //   swdi:   pointer to SWDIO captured data
 //   return: none
 #if (DAP_SWD != 0)
+#ifdef RAMFUNC_SWD_Sequence
+RAMFUNC(SWD_Sequence)
+#endif
 void SWD_Sequence (uint32_t info, const uint8_t *swdo, uint8_t *swdi) {
   uint32_t val;
   uint32_t bit;
   uint32_t n, k;
 
+  // The host may be selecting a target on a multidrop bus itself
+  swd_target_index = SWD_TARGET_HOST;
+  SWD_ForgetSelect();
+
   n = info & SWD_SEQUENCE_CLK;
   if (n == 0U) {
     n = 64U;
@@ -130,12 +274,25 @@ void SWD_Sequence (uint32_t info, const uint8_t *swdo, uint8_t *swdi) {
 #if (DAP_SWD != 0)
 
 
-// SWD Transfer I/O
-//   request: A[3:2] RnW APnDP
-//   data:    DATA[31:0]
-//   return:  ACK[2:0]
-#define SWD_TransferFunction(speed)     /**/                                    \
-static uint8_t SWD_Transfer##speed (uint32_t request, uint32_t *data) {         \
+// SWD request headers indexed by A[3:2] RnW APnDP: Start, APnDP, RnW,
+// A[3:2], Parity, Stop and Park, in the order they are clocked out
+static const uint8_t swd_header[16] = {
+  0x81U, 0xA3U, 0xA5U, 0x87U, 0xA9U, 0x8BU, 0x8DU, 0xAFU,
+  0xB1U, 0x93U, 0x95U, 0xB7U, 0x99U, 0xBBU, 0xBDU, 0x9FU
+};
+
+
+// SWD Transfer I/O, inlined into SWD_Transfer and SWD_TransferBatch
+//   request:     A[3:2] RnW APnDP
+//   data:        DATA[31:0]
+//   turnaround:  turnaround period in clocks
+//   idle_cycles: idle cycles after a transfer
+//   data_phase:  data phase on WAIT and FAULT
+//   return:      ACK[2:0]
+#define SWD_PacketFunction(speed)       /**/                                    \
+static inline __forceinline uint8_t SWD_Packet##speed (uint32_t request,        \
+    uint32_t *data, uint32_t turnaround, uint32_t idle_cycles,                  \
+    uint32_t data_phase) {                                                      \
   uint32_t ack;                                                                 \
   uint32_t bit;                                                                 \
   uint32_t val;                                                                 \
@@ -144,27 +301,19 @@ static uint8_t SWD_Transfer##speed (uint32_t request, uint32_t *data) {
   uint32_t n;                                                                   \
                                                                                 \
   /* Packet Request */                                                          \
-  parity = 0U;                                                                  \
-  SW_WRITE_BIT(1U);                     /* Start Bit */                         \
-  bit = request >> 0;                                                           \
-  SW_WRITE_BIT(bit);                    /* APnDP Bit */                         \
-  parity += bit;                                                                \
-  bit = request >> 1;                                                           \
-  SW_WRITE_BIT(bit);                    /* RnW Bit */                           \
-  parity += bit;                                                                \
-  bit = request >> 2;                                                           \
-  SW_WRITE_BIT(bit);                    /* A2 Bit */                            \
-  parity += bit;                                                                \
-  bit = request >> 3;                                                           \
-  SW_WRITE_BIT(bit);                    /* A3 Bit */                            \
-  parity += bit;                                                                \
-  SW_WRITE_BIT(parity);                 /* Parity Bit */                        \
-  SW_WRITE_BIT(0U);                     /* Stop Bit */                          \
-  SW_WRITE_BIT(1U);                     /* Park Bit */                          \
+  val = swd_header[request & 0x0FU];                                            \
+  SW_WRITE_BIT(val >> 0);               /* Start Bit */                         \
+  SW_WRITE_BIT(val >> 1);               /* APnDP Bit */                         \
+  SW_WRITE_BIT(val >> 2);               /* RnW Bit */                           \
+  SW_WRITE_BIT(val >> 3);               /* A2 Bit */                            \
+  SW_WRITE_BIT(val >> 4);               /* A3 Bit */                            \
+  SW_WRITE_BIT(val >> 5);               /* Parity Bit */                        \
+  SW_WRITE_BIT(val >> 6);               /* Stop Bit */                          \
+  SW_WRITE_BIT(val >> 7);               /* Park Bit */                          \
                                                                                 \
   /* Turnaround */                                                              \
   PIN_SWDIO_OUT_DISABLE();                                                      \
-  for (n = DAP_Data.swd_conf.turnaround; n; n--) {                              \
+  for (n = turnaround; n; n--) {                                                \
     SW_CLOCK_CYCLE();                                                           \
   }                                                                             \
                                                                                 \
@@ -194,13 +343,13 @@ static uint8_t SWD_Transfer##speed (uint32_t request, uint32_t *data) {
       }                                                                         \
       if (data) { *data = val; }                                                \
       /* Turnaround */                                                          \
-      for (n = DAP_Data.swd_conf.turnaround; n; n--) {                          \
+      for (n = turnaround; n; n--) {                                            \
         SW_CLOCK_CYCLE();                                                       \
       }                                                                         \
       PIN_SWDIO_OUT_ENABLE();                                                   \
     } else {                                                                    \
       /* Turnaround */                                                          \
-      for (n = DAP_Data.swd_conf.turnaround; n; n--) {                          \
+      for (n = turnaround; n; n--) {                                            \
         SW_CLOCK_CYCLE();                                                       \
       }                                                                         \
       PIN_SWDIO_OUT_ENABLE();                                                   \
@@ -219,7 +368,7 @@ static uint8_t SWD_Transfer##speed (uint32_t request, uint32_t *data) {
       DAP_Data.timestamp = TIMESTAMP_GET();                                     \
     }                                                                           \
     /* Idle cycles */                                                           \
-    n = DAP_Data.transfer.idle_cycles;                                          \
+    n = idle_cycles;                                                            \
     if (n) {                                                                    \
       PIN_SWDIO_OUT(0U);                                                        \
       for (; n; n--) {                                                          \
@@ -232,17 +381,17 @@ static uint8_t SWD_Transfer##speed (uint32_t request, uint32_t *data) {
                                                                                 \
   if ((ack == DAP_TRANSFER_WAIT) || (ack == DAP_TRANSFER_FAULT)) {              \
     /* WAIT or FAULT response */                                                \
-    if (DAP_Data.swd_conf.data_phase && ((request & DAP_TRANSFER_RnW) != 0U)) { \
+    if (data_phase && ((request & DAP_TRANSFER_RnW) != 0U)) {                   \
       for (n = 32U+1U; n; n--) {                                                \
         SW_CLOCK_CYCLE();               /* Dummy Read RDATA[0:31] + Parity */   \
       }                                                                         \
     }                                                                           \
     /* Turnaround */                                                            \
-    for (n = DAP_Data.swd_conf.turnaround; n; n--) {                            \
+    for (n = turnaround; n; n--) {                                              \
       SW_CLOCK_CYCLE();                                                         \
     }                                                                           \
     PIN_SWDIO_OUT_ENABLE();                                                     \
-    if (DAP_Data.swd_conf.data_phase && ((request & DAP_TRANSFER_RnW) == 0U)) { \
+    if (data_phase && ((request & DAP_TRANSFER_RnW) == 0U)) {                   \
       PIN_SWDIO_OUT(0U);                                                        \
       for (n = 32U+1U; n; n--) {                                                \
         SW_CLOCK_CYCLE();               /* Dummy Write WDATA[0:31] + Parity */  \
@@ -253,7 +402,7 @@ static uint8_t SWD_Transfer##speed (uint32_t request, uint32_t *data) {
   }                                                                             \
                                                                                 \
   /* Protocol error */                                                          \
-  for (n = DAP_Data.swd_conf.turnaround + 32U + 1U; n; n--) {                   \
+  for (n = turnaround + 32U + 1U; n; n--) {                                     \
     SW_CLOCK_CYCLE();                   /* Back off data phase */               \
   }                                                                             \
   PIN_SWDIO_OUT_ENABLE();                                                       \
@@ -261,14 +410,265 @@ static uint8_t SWD_Transfer##speed (uint32_t request, uint32_t *data) {
   return ((uint8_t)ack);                                                        \
 }
 
+// SWD Transfer I/O
+//   request: A[3:2] RnW APnDP
+//   data:    DATA[31:0]
+//   return:  ACK[2:0]
+#define SWD_TransferFunction(speed)     /**/                                    \
+static uint8_t SWD_Transfer##speed (uint32_t request, uint32_t *data) {         \
+  return SWD_Packet##speed(request, data, DAP_Data.swd_conf.turnaround,         \
+                           DAP_Data.transfer.idle_cycles,                       \
+                           DAP_Data.swd_conf.data_phase);                       \
+}
+
+
+#if (DAP_SWD_BATCH != 0)
+
+// SWD Transfer of a whole DAP_Transfer request without value match, match
+// mask or timestamps, in one loop. Posted AP reads and the check of the last
+// write follow DAP_SWD_Transfer. The DP writes SWD_Transfer keeps track of
+// for multidrop (CTRL/STAT, SELECT and TARGETSEL) still go through it.
+//   request:  transfer requests, each write followed by its data
+//   count:    number of transfer requests
+//   response: transfer data
+//   return:   number of bytes in response data (upper 16 bits)
+//             number of transfers done (bits 15..8)
+//             last ACK (lower 8 bits)
+#define SWD_TransferBatchFunction(speed) /**/                                   \
+static uint32_t SWD_TransferBatch##speed (const uint8_t *request,               \
+                                          uint32_t count, uint8_t *response) {  \
+  uint8_t  *response_head = response;                                           \
+  uint32_t  turnaround  = DAP_Data.swd_conf.turnaround;                         \
+  uint32_t  idle_cycles = DAP_Data.transfer.idle_cycles;                        \
+  uint32_t  data_phase  = DAP_Data.swd_conf.data_phase;                         \
+  uint32_t  post_read   = 0U;                                                   \
+  uint32_t  check_write = 0U;                                                   \
+  uint32_t  done = 0U;                                                          \
+  uint32_t  ack  = 0U;                                                          \
+  uint32_t  request_value;                                                      \
+  uint32_t  request_size;                                                       \
+  uint32_t  store;                                                              \
+  uint32_t  retry;                                                              \
+  uint32_t  data;                                                               \
+                                                                                \
+  SWD_EndOnes();                                                                \
+                                                                                \
+  for (;;) {                                                                    \
+    /* Pick the next packet: request_size is zero while the request */          \
+    /* waits for a posted AP read to be collected */                            \
+    if (count != 0U) {                                                          \
+      request_value = *request & 0x0FU;                                         \
+      if ((request_value & DAP_TRANSFER_RnW) == 0U) {                           \
+        if (post_read) {                                                        \
+          request_value = DP_RDBUFF | DAP_TRANSFER_RnW;                         \
+          request_size = 0U;                                                    \
+          store = 1U;                                                           \
+          post_read = 0U;                                                       \
+        } else {                                                                \
+          data = (uint32_t)(*(request+1) <<  0) |                               \
+                 (uint32_t)(*(request+2) <<  8) |                               \
+                 (uint32_t)(*(request+3) << 16) |                               \
+                 (uint32_t)(*(request+4) << 24);                                \
+          request_size = 5U;                                                    \
+          store = 0U;                                                           \
+          /* Nothing answers until DPIDR has been read after a TARGETSEL */     \
+          check_write = (request_value != DP_TARGETSEL) ? 1U : 0U;              \
+        }                                                                       \
+      } else if ((request_value & DAP_TRANSFER_APnDP) != 0U) {                  \
+        request_size = 1U;                                                      \
+        store = post_read;                                                      \
+        post_read = 1U;                                                         \
+        check_write = 0U;                                                       \
+      } else if (post_read) {                                                   \
+        request_value = DP_RDBUFF | DAP_TRANSFER_RnW;                           \
+        request_size = 0U;                                                      \
+        store = 1U;                                                             \
+        post_read = 0U;                                                         \
+      } else {                                                                  \
+        request_size = 1U;                                                      \
+        store = 1U;                                                             \
+        check_write = 0U;                                                       \
+      }                                                                         \
+    } else if (post_read) {                                                     \
+      /* Read last AP data */                                                   \
+      request_value = DP_RDBUFF | DAP_TRANSFER_RnW;                             \
+      request_size = 0U;                                                        \
+      store = 1U;                                                               \
+      post_read = 0U;                                                           \
+    } else if (check_write) {                                                   \
+      /* Check last write */                                                    \
+      request_value = DP_RDBUFF | DAP_TRANSFER_RnW;                             \
+      request_size = 0U;                                                        \
+      store = 0U;                                                               \
+      check_write = 0U;                                                         \
+    } else {                                                                    \
+      break;                                                                    \
+    }                                                                           \
+                                                                                \
+    retry = DAP_Data.transfer.retry_count;                                      \
+    if (((request_value & (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW)) == 0U) &&    \
+        (request_value != DP_ABORT)) {                                          \
+      do {                                                                      \
+        ack = SWD_Transfer(request_value, &data);                               \
+      } while ((ack == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);    \
+    } else {                                                                    \
+      do {                                                                      \
+        if (request_value == swd_wait_request) {                                \
+          SWD_WaitIdle();                                                       \
+        }                                                                       \
+        ack = SWD_Packet##speed(request_value, &data, turnaround,               \
+                                idle_cycles, data_phase);                       \
+        if (ack != DAP_TRANSFER_OK) {                                           \
+          SWD_NotOK(request_value, ack);                                        \
+        }                                                                       \
+      } while ((ack == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);    \
+      if (ack == DAP_TRANSFER_OK) {                                             \
+        swd_wait_request = SWD_WAIT_NONE;                                       \
+      } else if ((ack != DAP_TRANSFER_WAIT) && (ack != DAP_TRANSFER_FAULT)) {   \
+        /* No response: the target may have been reset */                       \
+        SWD_ForgetSelect();                                                     \
+      }                                                                         \
+    }                                                                           \
+    if (ack != DAP_TRANSFER_OK) {                                               \
+      break;                                                                    \
+    }                                                                           \
+                                                                                \
+    if (store) {                                                                \
+      *response++ = (uint8_t) data;                                             \
+      *response++ = (uint8_t)(data >>  8);                                      \
+      *response++ = (uint8_t)(data >> 16);                                      \
+      *response++ = (uint8_t)(data >> 24);                                      \
+    }                                                                           \
+    if (request_size != 0U) {                                                   \
+      request += request_size;                                                  \
+      count--;                                                                  \
+      done++;                                                                   \
+      if (DAP_TransferAbort) {                                                  \
+        count = 0U;                                                             \
+      }                                                                         \
+    }                                                                           \
+  }                                                                             \
+                                                                                \
+  return (((uint32_t)(response - response_head) << 16) | (done << 8) | ack);    \
+}
+
+#endif  /* (DAP_SWD_BATCH != 0) */
+
 
 #undef  PIN_DELAY
 #define PIN_DELAY() PIN_DELAY_FAST()
+SWD_PacketFunction(Fast)
+#ifdef RAMFUNC_SWD_TransferFast
+RAMFUNC(SWD_TransferFast)
+#endif
 SWD_TransferFunction(Fast)
+#if (DAP_SWD_BATCH != 0)
+#ifdef RAMFUNC_SWD_TransferBatchFast
+RAMFUNC(SWD_TransferBatchFast)
+#endif
+SWD_TransferBatchFunction(Fast)
+#endif
 
 #undef  PIN_DELAY
 #define PIN_DELAY() PIN_DELAY_SLOW(DAP_Data.clock_delay)
+SWD_PacketFunction(Slow)
 SWD_TransferFunction(Slow)
+#if (DAP_SWD_BATCH != 0)
+SWD_TransferBatchFunction(Slow)
+#endif
+
+
+#if (DAP_SWD_MULTIDROP != 0)
+// Write TARGETSEL, which no target acknowledges: the ACK phase is clocked
+// with SWDIO released and ignored. Makes the target's entry current.
+//   targetsel: TARGETSEL value
+//   return:    none
+static void SWD_WriteTargetSel (uint32_t targetsel) {
+  uint32_t parity;
+  uint32_t val;
+  uint32_t n;
+
+  SWD_EndOnes();
+
+  /* Packet Request: Start, DP, Write, A[3:2] = 3, Parity 0, Stop, Park */
+  val = 0x99U;
+  for (n = 8U; n; n--) {
+    SW_WRITE_BIT(val);
+    val >>= 1;
+  }
+
+  /* Turnaround, ACK and turnaround, with no target driving SWDIO */
+  PIN_SWDIO_OUT_DISABLE();
+  for (n = (2U * DAP_Data.swd_conf.turnaround) + 3U; n; n--) {
+    SW_CLOCK_CYCLE();
+  }
+  PIN_SWDIO_OUT_ENABLE();
+
+  val = targetsel;
+  parity = 0U;
+  for (n = 32U; n; n--) {
+    SW_WRITE_BIT(val);                  /* Write WDATA[0:31] */
+    parity += val;
+    val >>= 1;
+  }
+  SW_WRITE_BIT(parity);                 /* Write Parity Bit */
+  PIN_SWDIO_OUT(1U);
+
+  for (n = 0U; n < SWD_TARGET_COUNT; n++) {
+    if (swd_target[n].targetsel == targetsel) {
+      break;
+    }
+  }
+  if (n == SWD_TARGET_COUNT) {
+    n = swd_target_next;
+    swd_target_next = (uint8_t)((n + 1U) % SWD_TARGET_COUNT);
+    swd_target[n].targetsel = targetsel;
+    swd_target[n].known = 0U;
+  }
+  swd_target_index = (uint8_t)n;
+}
+
+
+// Select a target on a multidrop bus: a line reset, then a TARGETSEL write.
+// The host has to read DPIDR next.
+//   targetsel: TARGETSEL value
+//   return:    none
+void SWD_TargetSelect (uint32_t targetsel) {
+  static const uint8_t reset[8] = {
+    0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0x00U
+  };
+
+  SWD_TrackSequence(64U, reset);
+  SWJ_Sequence(64U, reset);             /* Line reset and idle cycles */
+  SWD_WriteTargetSel(targetsel);
+}
+#endif
+
+
+// Read the SELECT value last written to the DP of the current target
+//   select: SELECT value
+//   return: 1 when the DP is known to hold it, 0 otherwise
+uint32_t SWD_GetSelect (uint32_t *select) {
+  *select = swd_target[swd_target_index].select;
+  return swd_target[swd_target_index].known;
+}
+
+
+// Read the counts of responses other than OK
+//   stats:  WAIT, FAULT and protocol error counts for DP accesses, followed
+//           by the same for AP accesses
+//   clear:  reset the counts once read
+//   return: none
+void SWD_ReadAckStats (uint32_t *stats, uint32_t clear) {
+  uint32_t n;
+
+  for (n = 0U; n < 6U; n++) {
+    stats[n] = swd_ack_stats[n / 3U][n % 3U];
+    if (clear) {
+      swd_ack_stats[n / 3U][n % 3U] = 0U;
+    }
+  }
+}
 
 
 // SWD Transfer I/O
@@ -276,12 +676,79 @@ SWD_TransferFunction(Slow)
 //   data:    DATA[31:0]
 //   return:  ACK[2:0]
 uint8_t  SWD_Transfer(uint32_t request, uint32_t *data) {
+  uint32_t known;
+  uint8_t ack;
+
+  SWD_EndOnes();
+
+  switch (request & 0x0FU) {
+#if (DAP_SWD_MULTIDROP != 0)
+    case DP_TARGETSEL:
+      SWD_WriteTargetSel(*data);
+      return DAP_TRANSFER_OK;
+    case DP_SELECT:
+      if ((swd_target_index != SWD_TARGET_HOST) && swd_target[swd_target_index].known &&
+          (swd_target[swd_target_index].select == *data)) {
+        // The DP already holds this value
+        return DAP_TRANSFER_OK;
+      }
+      break;
+#endif
+    case DP_CTRL_STAT:
+      // Powering up the debug domain: the DPs may have been reset. The
+      // entry of the host's own target skips no writes, and is kept so
+      // that MEM_ReleaseAp can put SELECT back.
+      known = swd_target[SWD_TARGET_HOST].known;
+      SWD_ForgetSelect();
+      swd_target[SWD_TARGET_HOST].known = (uint8_t)known;
+      break;
+    default:
+      break;
+  }
+
+  if ((request & 0x0FU) == swd_wait_request) {
+    SWD_WaitIdle();
+  }
   if (DAP_Data.fast_clock) {
-    return SWD_TransferFast(request, data);
+    ack = SWD_TransferFast(request, data);
+  } else {
+    ack = SWD_TransferSlow(request, data);
+  }
+  if (ack != DAP_TRANSFER_OK) {
+    SWD_NotOK(request, ack);
   } else {
-    return SWD_TransferSlow(request, data);
+    swd_wait_request = SWD_WAIT_NONE;
+  }
+
+  if ((request & 0x0FU) == DP_SELECT) {
+    swd_target[swd_target_index].select = *data;
+    swd_target[swd_target_index].known = (ack == DAP_TRANSFER_OK) ? 1U : 0U;
+  } else if ((ack != DAP_TRANSFER_OK) && (ack != DAP_TRANSFER_WAIT) && (ack != DAP_TRANSFER_FAULT)) {
+    // No response: the target may have been reset
+    SWD_ForgetSelect();
   }
+  return ack;
 }
 
 
+#if (DAP_SWD_BATCH != 0)
+
+// SWD Transfer of a whole DAP_Transfer request without value match, match
+// mask or timestamps
+//   request:  transfer requests, each write followed by its data
+//   count:    number of transfer requests
+//   response: transfer data
+//   return:   number of bytes in response data (upper 16 bits)
+//             number of transfers done (bits 15..8)
+//             last ACK (lower 8 bits)
+uint32_t SWD_TransferBatch (const uint8_t *request, uint32_t count, uint8_t *response) {
+  if (DAP_Data.fast_clock) {
+    return SWD_TransferBatchFast(request, count, response);
+  }
+  return SWD_TransferBatchSlow(request, count, response);
+}
+
+#endif
+
+
 #endif  /* (DAP_SWD != 0) */
@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2026, Devan Lai
+ *
+ * Permission to use, copy, modify, and/or distribute this software
+ * for any purpose with or without fee is hereby granted, provided
+ * that the above copyright notice and this permission notice
+ * appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "DAP/CMSIS_DAP_hal.h"
+#include "DAP/CMSIS_DAP.h"
+#include "config.h"
+#include "tick.h"
+
+#if PC_SAMPLE_AVAILABLE
+
+#if (DAP_MEMORY == 0)
+#error "PC sampling claims the MEM-AP through the memory engine: set DAP_MEMORY"
+#endif
+
+#if !SWO_STREAM_AVAILABLE
+#error "PC samples are sent on the SWO trace endpoint: set SWO_STREAM_AVAILABLE"
+#endif
+
+/*
+ * Statistical profiling of the target's PC, sent on the trace endpoint of the
+ * bulk interface. Each sample is 8 bytes: the time in microseconds since
+ * sampling started and the PC, both little-endian. A PC of 0xFFFFFFFF means
+ * the core was halted.
+ *
+ * Samples are taken while the DAP app has no requests to work on. The PC is
+ * read from DWT_PCSR, or on cores without it (such as the Cortex-M0), by
+ * halting the core, reading PC and resuming it. The reads go through the
+ * MEM-AP that SELECT pointed at when sampling started. Setting up SELECT,
+ * CSW and TAR for that is left in place from one sample to the next, and
+ * only put back once the host sends a request, so that taking a sample from
+ * DWT_PCSR is a single AP read.
+ */
+
+// MEM-AP registers, as DAP_Transfer request bits
+#define SAMPLE_AP_TAR           (DAP_TRANSFER_APnDP | DAP_TRANSFER_A2)
+#define SAMPLE_AP_DRW           (DAP_TRANSFER_APnDP | DAP_TRANSFER_A2 | DAP_TRANSFER_A3)
+
+#define SAMPLE_CSW_SIZE         0x07U
+#define SAMPLE_CSW_ADDRINC      0x30U
+#define SAMPLE_CSW_SIZE32       0x02U
+
+// Debug registers
+#define SAMPLE_DWT_PCSR         0xE000101CU
+#define SAMPLE_DHCSR            0xE000EDF0U
+#define SAMPLE_DCRSR            0xE000EDF4U
+#define SAMPLE_DCRDR            0xE000EDF8U
+
+#define SAMPLE_DHCSR_DBGKEY     0xA05F0000U
+#define SAMPLE_DHCSR_C_DEBUGEN  (1U << 0)
+#define SAMPLE_DHCSR_C_HALT     (1U << 1)
+#define SAMPLE_DHCSR_S_HALT     (1U << 17)
+
+#define SAMPLE_REG_PC           15U
+
+/// PC reported for a halted core
+#define SAMPLE_PC_HALTED        0xFFFFFFFFU
+
+/// Read PC by halting the core instead of from DWT_PCSR
+#define SAMPLE_FLAG_HALT        0x01U
+
+#define SAMPLE_PACKET_SIZE      64U
+#define SAMPLE_RECORD_SIZE      8U
+
+static struct {
+    uint8_t  index;         ///< DAP index of the JTAG device
+    uint8_t  flags;
+    bool     owned;         ///< SELECT, CSW and TAR are set up for sampling
+    bool     zlp;           ///< Last packet sent was full-sized
+    uint32_t ap;            ///< SELECT value for the MEM-AP
+    MEM_Saved_t saved;      ///< The host's SELECT, CSW and TAR, to put back
+    uint32_t period;        ///< Microseconds between samples, 0 when off
+    uint32_t now;           ///< Microseconds since sampling started
+    uint32_t stamp;         ///< get_timestamp() at now
+    uint32_t next;          ///< Time of the next sample
+    uint8_t  fill;
+    uint8_t  packet[SAMPLE_PACKET_SIZE];
+} sample;
+
+static uint32_t sample_get32(const uint8_t* buf) {
+    return ((uint32_t)buf[0] <<  0) |
+           ((uint32_t)buf[1] <<  8) |
+           ((uint32_t)buf[2] << 16) |
+           ((uint32_t)buf[3] << 24);
+}
+
+static void sample_put32(uint8_t* buf, uint32_t value) {
+    buf[0] = (uint8_t)(value >>  0);
+    buf[1] = (uint8_t)(value >>  8);
+    buf[2] = (uint8_t)(value >> 16);
+    buf[3] = (uint8_t)(value >> 24);
+}
+
+// Whether SWO trace is being streamed on the trace endpoint
+static bool sample_trace_busy(void) {
+#if (SWO_STREAM != 0)
+    return (SWO_Streaming() != 0U);
+#else
+    return false;
+#endif
+}
+
+// Carry whole microseconds over from the timestamp counter
+static uint32_t sample_update_time(void) {
+    uint32_t counts_per_us = get_timestamp_counts_per_us();
+    uint32_t us = (get_timestamp() - sample.stamp) / counts_per_us;
+
+    sample.stamp += us * counts_per_us;
+    sample.now += us;
+    return sample.now;
+}
+
+// Point TAR at the register sampled from, saving the host's SELECT, CSW
+// and TAR
+static uint8_t sample_claim(void) {
+    uint32_t addr = (sample.flags & SAMPLE_FLAG_HALT) ? SAMPLE_DHCSR : SAMPLE_DWT_PCSR;
+    uint8_t ack;
+
+    ack = MEM_ClaimAp(sample.index, sample.ap, &sample.saved);
+    if (ack != DAP_TRANSFER_OK) {
+        return ack;
+    }
+    sample.owned = true;
+    return MEM_SetCswTar(sample.index,
+                         (sample.saved.csw & ~(SAMPLE_CSW_SIZE | SAMPLE_CSW_ADDRINC)) | SAMPLE_CSW_SIZE32,
+                         addr);
+}
+
+// Put back the host's SELECT, CSW and TAR, clearing a sticky error left by
+// the samples
+//   ack:    result of the last sample
+//   return: ack, or the result of putting them back if that failed
+static uint8_t sample_release(uint8_t ack) {
+    if (sample.owned) {
+        sample.owned = false;
+        ack = MEM_ReleaseAp(sample.index, &sample.saved, ack);
+    }
+    return ack;
+}
+
+// Read DRW at the address TAR was left at
+static uint8_t sample_read(uint32_t* value) {
+    const uint8_t request[4] = { ID_DAP_Transfer, sample.index, 1U,
+                                 SAMPLE_AP_DRW | DAP_TRANSFER_RnW };
+    uint8_t response[7];
+
+    DAP_ProcessCommand(request, response);
+    *value = sample_get32(&response[3]);
+    return response[2];
+}
+
+// Halt the core just long enough to read PC, unless it's already halted
+static uint8_t sample_halt_read(uint32_t* pc) {
+    uint8_t request[3U + (5U * 6U) + 1U] = { ID_DAP_Transfer, sample.index, 7U };
+    uint8_t response[7];
+    uint32_t dhcsr = 0U;
+    uint8_t ack;
+    uint8_t* p;
+
+    ack = sample_read(&dhcsr);
+    if ((ack != DAP_TRANSFER_OK) || (dhcsr & SAMPLE_DHCSR_S_HALT)) {
+        *pc = SAMPLE_PC_HALTED;
+        return ack;
+    }
+
+    p = &request[3];
+    *p++ = SAMPLE_AP_DRW;
+    sample_put32(p, SAMPLE_DHCSR_DBGKEY | SAMPLE_DHCSR_C_HALT | SAMPLE_DHCSR_C_DEBUGEN);
+    p += 4;
+    *p++ = SAMPLE_AP_TAR;
+    sample_put32(p, SAMPLE_DCRSR);
+    p += 4;
+    *p++ = SAMPLE_AP_DRW;
+    sample_put32(p, SAMPLE_REG_PC);
+    p += 4;
+    *p++ = SAMPLE_AP_TAR;
+    sample_put32(p, SAMPLE_DCRDR);
+    p += 4;
+    *p++ = SAMPLE_AP_DRW | DAP_TRANSFER_RnW;
+    *p++ = SAMPLE_AP_TAR;
+    sample_put32(p, SAMPLE_DHCSR);
+    p += 4;
+    *p++ = SAMPLE_AP_DRW;
+    sample_put32(p, SAMPLE_DHCSR_DBGKEY | SAMPLE_DHCSR_C_DEBUGEN);
+
+    DAP_ProcessCommand(request, response);
+    *pc = sample_get32(&response[3]);
+    return response[2];
+}
+
+// Send the samples taken so far if the trace endpoint is idle
+static void sample_flush(void) {
+    if (sample.fill != 0U) {
+        if (SAMPLE_QueueTransfer(sample.packet, sample.fill) != 0U) {
+            sample.zlp = (sample.fill == SAMPLE_PACKET_SIZE);
+            sample.fill = 0U;
+        }
+    } else if (sample.zlp) {
+        // End the host's transfer once the samples stop coming
+        if (SAMPLE_QueueTransfer(NULL, 0U) != 0U) {
+            sample.zlp = false;
+        }
+    }
+}
+
+// Process PC Sample vendor command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t SAMPLE_Start(const uint8_t* request, uint8_t* response) {
+    uint32_t period = sample_get32(&request[3]);
+    uint8_t ack;
+
+    SAMPLE_Stop();
+    response[0] = request[0];
+    response[1] = DAP_TRANSFER_OK;
+
+    if (period == 0U) {
+        return ((7U << 16) | 2U);
+    }
+    if (((request[2] & ~SAMPLE_FLAG_HALT) != 0U) || sample_trace_busy()) {
+        response[1] = DAP_ERROR;
+        return ((7U << 16) | 2U);
+    }
+    ack = MEM_GetAp(request[1], &sample.ap);
+    if (ack != DAP_TRANSFER_OK) {
+        response[1] = ack;
+        return ((7U << 16) | 2U);
+    }
+
+    sample.index = request[1];
+    sample.flags = request[2];
+    sample.period = period;
+    sample.now = 0U;
+    sample.next = 0U;
+    sample.stamp = get_timestamp();
+    return ((7U << 16) | 2U);
+}
+
+// Whether the next sample is due. Only reads the state, so that it can be
+// called from outside the context that samples.
+uint32_t SAMPLE_Due(void) {
+    if ((sample.period == 0U) || sample_trace_busy()) {
+        return 0U;
+    }
+    return (((get_timestamp() - sample.stamp) / get_timestamp_counts_per_us()) >=
+            (sample.next - sample.now)) ? 1U : 0U;
+}
+
+// Take a sample and send what's been packed so far. A failed access stops
+// sampling.
+void SAMPLE_Poll(void) {
+    uint32_t now = sample_update_time();
+    uint32_t pc = SAMPLE_PC_HALTED;
+    uint8_t ack = DAP_TRANSFER_OK;
+
+    // Keep to the period, without trying to catch up on missed samples
+    sample.next += sample.period;
+    if ((int32_t)(now - sample.next) >= 0) {
+        sample.next = now + sample.period;
+    }
+
+    // Drop the sample if the last packet is still waiting to be sent
+    sample_flush();
+    if (sample.fill == SAMPLE_PACKET_SIZE) {
+        return;
+    }
+
+    if (!sample.owned) {
+        ack = sample_claim();
+    }
+    if (ack == DAP_TRANSFER_OK) {
+        ack = (sample.flags & SAMPLE_FLAG_HALT) ? sample_halt_read(&pc) : sample_read(&pc);
+    }
+    if (ack != DAP_TRANSFER_OK) {
+        sample.period = 0U;
+        (void)sample_release(ack);
+        return;
+    }
+
+    sample_put32(&sample.packet[sample.fill], now);
+    sample_put32(&sample.packet[sample.fill + 4U], pc);
+    sample.fill += SAMPLE_RECORD_SIZE;
+    sample_flush();
+}
+
+// Put back the host's SELECT, CSW and TAR before it makes its next access.
+// Sampling stops if that fails.
+void SAMPLE_Release(void) {
+    if (sample_release(DAP_TRANSFER_OK) != DAP_TRANSFER_OK) {
+        sample.period = 0U;
+    }
+}
+
+// Stop sampling and drop any samples that haven't been sent
+void SAMPLE_Stop(void) {
+    sample.period = 0U;
+    sample.fill = 0U;
+    sample.zlp = false;
+}
+
+// Forget about SELECT, CSW and TAR, as after a DAP_Setup
+void SAMPLE_Reset(void) {
+    SAMPLE_Stop();
+    sample.owned = false;
+}
+
+#endif
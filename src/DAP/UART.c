@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2026, Devan Lai
+ *
+ * Permission to use, copy, modify, and/or distribute this software
+ * for any purpose with or without fee is hereby granted, provided
+ * that the above copyright notice and this permission notice
+ * appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <libopencm3/stm32/usart.h>
+
+#include "DAP/CMSIS_DAP_hal.h"
+#include "DAP/CMSIS_DAP.h"
+#include "console.h"
+
+#if (DAP_UART != 0)
+
+/*
+ * The DAP UART commands drive the console USART. With the DAP command
+ * transport selected, the USART is claimed from the USB-serial bridge and
+ * data moves through the console's DMA RX ring and TX buffer instead.
+ */
+_Static_assert(CDC_AVAILABLE, "DAP UART borrows the console USART");
+_Static_assert(DAP_UART_RX_BUFFER_SIZE == CONSOLE_RX_BUFFER_SIZE,
+               "DAP UART receives into the console RX buffer");
+_Static_assert(DAP_UART_TX_BUFFER_SIZE == CONSOLE_TX_BUFFER_SIZE,
+               "DAP UART transmits from the console TX buffer");
+
+/// Line settings used until the debugger configures the UART.
+#define DAP_UART_DEFAULT_BAUDRATE   115200U
+
+static uint8_t  uart_transport = DAP_UART_TRANSPORT_USB_COM_PORT;
+static bool     uart_rx_enabled = false;
+static bool     uart_tx_enabled = false;
+static uint32_t uart_lost_reported = 0U;    ///< RX bytes lost as of the last status
+
+static void uart_put32(uint8_t* buf, uint32_t value) {
+    buf[0] = (uint8_t)(value >>  0);
+    buf[1] = (uint8_t)(value >>  8);
+    buf[2] = (uint8_t)(value >> 16);
+    buf[3] = (uint8_t)(value >> 24);
+}
+
+static bool uart_claimed(void) {
+    return uart_transport == DAP_UART_TRANSPORT_DAP_COMMAND;
+}
+
+// Configuring the USART restarts the DMA, which also re-enables RX
+static bool uart_claim(uint32_t baudrate, uint32_t databits,
+                       uint32_t stopbits, uint32_t parity) {
+    if (!console_claim(baudrate, databits, stopbits, parity)) {
+        return false;
+    }
+    console_recv_enable(uart_rx_enabled);
+    uart_lost_reported = 0U;
+    return true;
+}
+
+// Process UART Transport command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t UART_Transport(const uint8_t* request, uint8_t* response) {
+    uint8_t transport = request[0];
+    uint8_t result = DAP_OK;
+
+    switch (transport) {
+        case DAP_UART_TRANSPORT_NONE:
+        case DAP_UART_TRANSPORT_USB_COM_PORT:
+            // Either way, the USART goes back to the USB-serial bridge
+            if (uart_claimed()) {
+                console_release();
+            }
+            uart_transport = transport;
+            break;
+        case DAP_UART_TRANSPORT_DAP_COMMAND:
+            if (!uart_claimed()) {
+                uart_rx_enabled = false;
+                uart_tx_enabled = false;
+                // Fails while SWO trace is being captured
+                if (uart_claim(DAP_UART_DEFAULT_BAUDRATE, 8, USART_STOPBITS_1,
+                               USART_PARITY_NONE)) {
+                    uart_transport = transport;
+                } else {
+                    result = DAP_ERROR;
+                }
+            }
+            break;
+        default:
+            result = DAP_ERROR;
+            break;
+    }
+
+    response[0] = result;
+    return ((1U << 16) | 1U);
+}
+
+// Process UART Configure command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t UART_Configure(const uint8_t* request, uint8_t* response) {
+    uint8_t control = request[0];
+    uint32_t baudrate = (uint32_t)(request[1] <<  0) |
+                        (uint32_t)(request[2] <<  8) |
+                        (uint32_t)(request[3] << 16) |
+                        (uint32_t)(request[4] << 24);
+    uint8_t status = 0U;
+    uint32_t databits = 8U;
+    uint32_t parity = USART_PARITY_NONE;
+    uint32_t stopbits = USART_STOPBITS_1;
+
+    // The USART frame is 8 or 9 bits including parity
+    switch (control & 0x07U) {
+        case 0U:
+            databits = 8U;
+            break;
+        case 7U:
+            databits = 7U;
+            break;
+        default:
+            status |= DAP_UART_CFG_ERROR_DATA_BITS;
+            break;
+    }
+
+    switch ((control >> 3) & 0x07U) {
+        case 0U:
+            parity = USART_PARITY_NONE;
+            break;
+        case 1U:
+            parity = USART_PARITY_EVEN;
+            break;
+        case 2U:
+            parity = USART_PARITY_ODD;
+            break;
+        default:
+            status |= DAP_UART_CFG_ERROR_PARITY;
+            break;
+    }
+
+    if ((databits == 7U) && (parity == USART_PARITY_NONE)) {
+        status |= DAP_UART_CFG_ERROR_DATA_BITS;
+    }
+
+    switch ((control >> 6) & 0x03U) {
+        case 0U:
+            stopbits = USART_STOPBITS_1;
+            break;
+        case 2U:
+            stopbits = USART_STOPBITS_2;
+            break;
+        default:
+            status |= DAP_UART_CFG_ERROR_STOP_BITS;
+            break;
+    }
+
+    if (!uart_claimed()) {
+        // Line settings for the USB COM port come from the host's driver
+        status |= DAP_UART_CFG_ERROR_DATA_BITS | DAP_UART_CFG_ERROR_PARITY |
+                  DAP_UART_CFG_ERROR_STOP_BITS;
+    }
+
+    if (status == 0U) {
+        baudrate = console_actual_baudrate(baudrate);
+        if ((baudrate == 0U) || !uart_claim(baudrate, databits, stopbits, parity)) {
+            status |= DAP_UART_CFG_ERROR_DATA_BITS;
+            baudrate = 0U;
+        }
+    } else {
+        baudrate = 0U;
+    }
+
+    response[0] = status;
+    uart_put32(&response[1], baudrate);
+    return ((5U << 16) | 5U);
+}
+
+// Process UART Control command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t UART_Control(const uint8_t* request, uint8_t* response) {
+    uint8_t control = request[0];
+    uint8_t result = DAP_OK;
+
+    if (!uart_claimed()) {
+        result = DAP_ERROR;
+    } else {
+        if ((control & DAP_UART_CONTROL_RX_DISABLE) != 0U) {
+            uart_rx_enabled = false;
+            console_recv_enable(false);
+        } else if ((control & DAP_UART_CONTROL_RX_ENABLE) != 0U) {
+            uart_rx_enabled = true;
+            console_recv_enable(true);
+        }
+        if ((control & DAP_UART_CONTROL_RX_BUF_FLUSH) != 0U) {
+            console_recv_flush();
+        }
+
+        if ((control & DAP_UART_CONTROL_TX_DISABLE) != 0U) {
+            uart_tx_enabled = false;
+        } else if ((control & DAP_UART_CONTROL_TX_ENABLE) != 0U) {
+            uart_tx_enabled = true;
+        }
+        if ((control & DAP_UART_CONTROL_TX_BUF_FLUSH) != 0U) {
+            console_send_flush();
+        }
+    }
+
+    response[0] = result;
+    return ((1U << 16) | 1U);
+}
+
+// Process UART Status command and prepare response
+//   response: pointer to response data
+//   return:   number of bytes in response
+uint32_t UART_Status(uint8_t* response) {
+    uint8_t status = 0U;
+    uint32_t rx_count = 0U;
+    uint32_t tx_count = 0U;
+
+    if (uart_claimed()) {
+        if (uart_rx_enabled) {
+            status |= DAP_UART_STATUS_RX_ENABLED;
+        }
+        if (uart_tx_enabled) {
+            status |= DAP_UART_STATUS_TX_ENABLED;
+        }
+
+        // Report each overflow once
+        uint32_t lost = console_recv_lost();
+        if (lost != uart_lost_reported) {
+            uart_lost_reported = lost;
+            status |= DAP_UART_STATUS_RX_DATA_LOST;
+        }
+
+        rx_count = (uint32_t)console_recv_buffer_level();
+        tx_count = CONSOLE_TX_BUFFER_SIZE - (uint32_t)console_send_buffer_space();
+    }
+
+    response[0] = status;
+    uart_put32(&response[1], rx_count);
+    uart_put32(&response[5], tx_count);
+    return (9U);
+}
+
+// Process UART Transfer command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t UART_Transfer(const uint8_t* request, uint8_t* response) {
+    uint16_t rx_max = (uint16_t)(request[0] | (request[1] << 8));
+    uint16_t tx_req = (uint16_t)(request[2] | (request[3] << 8));
+    uint16_t tx_count = 0U;
+    uint16_t rx_count = 0U;
+    uint8_t status = 0U;
+
+    // Leave room for the command, status and count bytes
+    uint16_t rx_limit = DAP_GetPacketSize() - 6U;
+    uint16_t tx_limit = DAP_GetPacketSize() - 5U;
+    if (rx_max > rx_limit) {
+        rx_max = rx_limit;
+    }
+
+    if (uart_claimed()) {
+        if (uart_tx_enabled) {
+            status |= DAP_UART_STATUS_TX_ENABLED;
+            tx_count = (tx_req > tx_limit) ? tx_limit : tx_req;
+            tx_count = (uint16_t)console_send_buffered(&request[4], tx_count);
+        }
+
+        if (uart_rx_enabled) {
+            status |= DAP_UART_STATUS_RX_ENABLED;
+        }
+        // Data received before RX was disabled can still be read
+        while (rx_count < rx_max) {
+            uint16_t len = 0U;
+            const uint8_t* data = console_recv_peek(&len);
+            if (data == NULL) {
+                break;
+            }
+            if (len > (rx_max - rx_count)) {
+                len = rx_max - rx_count;
+            }
+            memcpy(&response[5U + rx_count], data, len);
+            console_recv_skip(len);
+            rx_count += len;
+        }
+
+        uint32_t lost = console_recv_lost();
+        if (lost != uart_lost_reported) {
+            uart_lost_reported = lost;
+            status |= DAP_UART_STATUS_RX_DATA_LOST;
+        }
+    }
+
+    response[0] = status;
+    response[1] = (uint8_t)(rx_count >> 0);
+    response[2] = (uint8_t)(rx_count >> 8);
+    response[3] = (uint8_t)(tx_count >> 0);
+    response[4] = (uint8_t)(tx_count >> 8);
+
+    // The whole request is consumed, even if not all of it fit
+    if (tx_req > tx_limit) {
+        tx_req = tx_limit;
+    }
+    return (((4U + tx_req) << 16) | (5U + rx_count));
+}
+
+// Process the vendor command that reads the UART statistics: the RX overflow
+// counters and the CPU time spent transmitting. Bit 0 of the request clears
+// the TX counters after reading them.
+//   request:  pointer to request data, starting with the command ID
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t UART_Stats(const uint8_t* request, uint8_t* response) {
+    uint32_t tx_irqs, tx_irq_us, elapsed_ms;
+
+    console_send_load(&tx_irqs, &tx_irq_us, &elapsed_ms);
+    if (request[1] & 0x01U) {
+        console_send_load_clear();
+    }
+
+    response[0] = request[0];
+    response[1] = DAP_OK;
+    uart_put32(&response[2], console_recv_lost());
+    uart_put32(&response[6], console_recv_overflows());
+    uart_put32(&response[10], tx_irqs);
+    uart_put32(&response[14], tx_irq_us);
+    uart_put32(&response[18], elapsed_ms);
+    return ((2U << 16) | 22U);
+}
+
+#endif
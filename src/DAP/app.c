@@ -19,6 +19,13 @@
 #include <stdint.h>
 #include <string.h>
 
+#if DAP_PENDSV
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/scb.h>
+#endif
+
+#include <libopencm3/cm3/cortex.h>
+
 #include "DAP/CMSIS_DAP_hal.h"
 #include "DAP/CMSIS_DAP.h"
 
@@ -30,6 +37,66 @@
 #if BULK_AVAILABLE
 #include "USB/bulk.h"
 #endif
+#include "tick.h"
+
+#if defined(__arm__)
+#define DAP_APP_BREAKPOINT(n) asm("bkpt #" #n)
+#else
+// Host builds of the DAP app
+#define DAP_APP_BREAKPOINT(n) __builtin_trap()
+#endif
+
+// Vendor command that reads (and optionally clears) the latency histogram
+#define ID_DAP_VENDOR_LATENCY ID_DAP_Vendor0
+
+// Vendor command that reads the UART overflow and transmit load counters
+#define ID_DAP_VENDOR_UART_STATS ID_DAP_Vendor1
+
+// Vendor commands that read and write target memory through the MEM-AP
+#define ID_DAP_VENDOR_MEM_READ  ID_DAP_Vendor2
+#define ID_DAP_VENDOR_MEM_WRITE ID_DAP_Vendor3
+
+// Vendor command that works out the CRC32 of target memory on the probe
+#define ID_DAP_VENDOR_MEM_CRC   ID_DAP_Vendor4
+
+// Vendor commands that program flash through an algorithm in target RAM
+#define ID_DAP_VENDOR_FLASH_SETUP   ID_DAP_Vendor5
+#define ID_DAP_VENDOR_FLASH_PROGRAM ID_DAP_Vendor6
+#define ID_DAP_VENDOR_FLASH_FINISH  ID_DAP_Vendor7
+
+// Vendor command that watches a target register, and the command that reads
+// what the watch has seen since it was last asked. The probe never sends a
+// packet that doesn't answer a request, so the host polls with the second.
+//   88 <index> <address:4> <mask:4> <interval:2>  ->  88 <status> <value:4>
+//   89                                            ->  89 <status> <changes> <value:4>
+// status is the response to the last read of the register, 0 when there is
+// no watch. changes counts the changes of the masked bits since the last 89,
+// up to 255, and value is the register as last read.
+#define ID_DAP_VENDOR_WATCH         ID_DAP_Vendor8
+#define ID_DAP_VENDOR_WATCH_EVENT   ID_DAP_Vendor9
+
+// Vendor command that bridges a SEGGER RTT channel to the virtual CDC port
+#define ID_DAP_VENDOR_RTT           ID_DAP_Vendor10
+
+// Vendor command that samples the target's PC onto the trace endpoint
+#define ID_DAP_VENDOR_PC_SAMPLE     ID_DAP_Vendor11
+
+// Vendor command that selects a target on an SWD multidrop bus
+#define ID_DAP_VENDOR_TARGET_SELECT ID_DAP_Vendor12
+
+// Vendor commands that drive a gang of identical targets in lockstep
+#define ID_DAP_VENDOR_GANG_SEQUENCE ID_DAP_Vendor13
+#define ID_DAP_VENDOR_GANG_TRANSFER ID_DAP_Vendor14
+
+// Vendor commands that set the idle cycles between SWD retries after WAIT,
+// and read the counts of WAIT, FAULT and protocol error responses
+#define ID_DAP_VENDOR_WAIT_BACKOFF  ID_DAP_Vendor15
+#define ID_DAP_VENDOR_ACK_STATS     ID_DAP_Vendor16
+
+// Bucket i counts commands answered within [2^i, 2^(i+1)) microseconds of
+// the request arriving; the last bucket also counts anything slower.
+// Sized so that the vendor command response fits in a HID report.
+#define DAP_LATENCY_BUCKETS 15
 
 enum UsbBufferKind {
     BUFFER_KIND_EMPTY,
@@ -43,10 +110,14 @@ enum UsbBufferKind {
 #endif
 };
 
+// Each slot owns both a request and its response, so packets are read
+// straight into the ring, executed into the response and sent from there.
 struct usb_buffer {
     uint8_t buffer_kind;
-    uint8_t data[DAP_PACKET_SIZE];
-    uint8_t size;
+    uint16_t size;
+    uint32_t timestamp;
+    uint8_t request[DAP_PACKET_SIZE];
+    uint8_t response[DAP_PACKET_SIZE];
 };
 
 static volatile struct usb_buffer buffers[DAP_PACKET_QUEUE_SIZE];
@@ -57,62 +128,546 @@ static volatile uint8_t inbox_tail;
 static volatile uint8_t process_head;
 // Outgoing data is read from here
 static volatile uint8_t outbox_head;
+// Responses up to here may be sent. It lags behind process_head while the
+// responses to DAP_QueueCommands requests are held back.
+static volatile uint8_t outbox_tail;
+
+#if BULK_AVAILABLE
+// Length of the bulk request being assembled in buffers[inbox_tail]
+static volatile uint16_t bulk_rx_len;
+#endif
+
+// Request kind of the last request, for the rest of a memory read to go out
+// on the same interface
+static uint8_t request_kind;
+
+// Response size of the command that holds the slot at process_head until
+// it's done
+static uint16_t pending_response_bytes;
 
 static GenericCallback dfu_request_callback = NULL;
 
+static volatile uint32_t latency_histogram[DAP_LATENCY_BUCKETS];
+
+#if DAP_PENDSV
+// Set whenever the PendSV handler did any work, for the activity LED
+static volatile bool pendsv_active;
+#endif
+
+// Set by a USB reset until the queue has been emptied
+static volatile bool reset_pending;
+
 _Static_assert(HID_AVAILABLE || BULK_AVAILABLE,
                "CMSIS-DAP needs at at least one transport interface class");
 
+#if HID_AVAILABLE
+_Static_assert(DAP_PACKET_SIZE >= USB_HID_MAX_PACKET_SIZE,
+               "DAP packets must hold a full HID report");
+#endif
+
+#if BULK_AVAILABLE
+_Static_assert((DAP_PACKET_SIZE % USB_BULK_MAX_PACKET_SIZE) == 0,
+               "DAP packets must be a whole number of bulk USB packets");
+#endif
+
+// Called once a request is complete and has been added to the inbox
+static void on_request_queued(volatile struct usb_buffer* buffer) {
+    buffer->timestamp = get_timestamp();
+#if DAP_PENDSV
+    SCB_ICSR = SCB_ICSR_PENDSVSET;
+#endif
+}
+
+// Called once the response at outbox_head has been sent. The slot it frees
+// makes room for another request if the OUT endpoints were held off.
+static void release_outbox_head(void) {
+    outbox_head = (outbox_head + 1) % DAP_PACKET_QUEUE_SIZE;
+#if HID_AVAILABLE
+    hid_resume_out();
+#endif
+#if BULK_AVAILABLE
+    bulk_resume_out();
+#endif
+#if DAP_PENDSV && (DAP_MEMORY != 0)
+    // The next packet of a memory read may have been waiting for the slot
+    if (MEM_ReadPending() != 0U) {
+        SCB_ICSR = SCB_ICSR_PENDSVSET;
+    }
+#endif
+}
+
+// Called as the response to a request starts going out to the host
+static void on_response_sent(volatile struct usb_buffer* buffer) {
+    uint32_t elapsed_us = (get_timestamp() - buffer->timestamp) / get_timestamp_counts_per_us();
+    uint8_t bucket = 0;
+    while ((elapsed_us > 1) && (bucket < DAP_LATENCY_BUCKETS - 1)) {
+        elapsed_us >>= 1;
+        bucket++;
+    }
+    latency_histogram[bucket]++;
+}
+
 // Goal: When there is a message received, store it in a buffer and increment
 // the buffer counter.
 
 #if HID_AVAILABLE
+static uint8_t* get_hid_report_buffer(uint16_t* len) {
+#if BULK_AVAILABLE
+    // Drop any partial bulk request that shares the inbox slot
+    bulk_rx_len = 0;
+#endif
+    *len = DAP_PACKET_SIZE;
+    return (uint8_t*)buffers[inbox_tail].request;
+}
+
 static bool on_receive_hid_report(uint8_t* data, uint16_t len) {
-    memcpy((void*)buffers[inbox_tail].data, (const void*)data, len);
-    buffers[inbox_tail].buffer_kind = BUFFER_KIND_HID;
-    buffers[inbox_tail].size = len;
+    volatile struct usb_buffer* buffer = &buffers[inbox_tail];
+
+    // Reports sent through SET_REPORT arrive in the control buffer
+    if (data != (uint8_t*)buffer->request) {
+#if BULK_AVAILABLE
+        bulk_rx_len = 0;
+#endif
+        if (len > DAP_PACKET_SIZE) {
+            len = DAP_PACKET_SIZE;
+        }
+        memcpy((void*)buffer->request, (const void*)data, len);
+    }
+    buffer->buffer_kind = BUFFER_KIND_HID;
+    buffer->size = len;
     inbox_tail = (inbox_tail + 1) % DAP_PACKET_QUEUE_SIZE;
+    on_request_queued(buffer);
 
     return ((inbox_tail + 1) % DAP_PACKET_QUEUE_SIZE) != outbox_head;
 }
 
-static void on_send_hid_report(uint8_t* data, uint16_t* len) {
-    if (outbox_head != process_head && buffers[outbox_head].buffer_kind == BUFFER_KIND_HID_RESPONSE) {
-        memcpy((void*)data, (const void*)buffers[outbox_head].data,
-               buffers[outbox_head].size);
-        *len = buffers[outbox_head].size;
+// The response at outbox_head is released once the HID endpoint has sent it.
+static const uint8_t* on_hid_report_sent(uint16_t* len) {
+    release_outbox_head();
 
-        outbox_head = (outbox_head + 1) % DAP_PACKET_QUEUE_SIZE;
-    } else {
-        *len = 0;
+    if (outbox_head != outbox_tail && buffers[outbox_head].buffer_kind == BUFFER_KIND_HID_RESPONSE) {
+        on_response_sent(&buffers[outbox_head]);
+        *len = buffers[outbox_head].size;
+        return (const uint8_t*)buffers[outbox_head].response;
     }
+
+    *len = 0;
+    return NULL;
 }
 #endif
 
 #if BULK_AVAILABLE
+// A request that fills its last USB packet exactly may not be followed by a
+// zero-length packet, so the length of every known command is worked out
+// from its header. An unknown command is complete at the end of a full USB
+// packet, unless it's nested in a batch, where its length is needed to find
+// the next command; then the batch ends at a short or zero-length packet.
+#define BULK_LENGTH_UNKNOWN 0xFFFFFFFFU
+
+// Returns the length of the command at the start of request, 0 if more of
+// it must arrive before the length is known, or BULK_LENGTH_UNKNOWN.
+static uint32_t bulk_command_length(const uint8_t* request, uint32_t len) {
+    uint32_t expected;
+    uint32_t count;
+    uint32_t bits;
+
+    switch (request[0]) {
+        case ID_DAP_Disconnect:
+        case ID_DAP_TransferAbort:
+        case ID_DAP_ResetTarget:
+        case ID_DAP_SWO_Status:
+        case ID_DAP_UART_Status:
+        case ID_DAP_VENDOR_WATCH_EVENT:
+        case ID_DAP_VENDOR_FLASH_FINISH:
+            expected = 1;
+            break;
+        case ID_DAP_Info:
+        case ID_DAP_Connect:
+        case ID_DAP_SWD_Configure:
+        case ID_DAP_JTAG_IDCODE:
+        case ID_DAP_SWO_Transport:
+        case ID_DAP_SWO_Mode:
+        case ID_DAP_SWO_Control:
+        case ID_DAP_SWO_ExtendedStatus:
+        case ID_DAP_UART_Transport:
+        case ID_DAP_UART_Control:
+        case ID_DAP_VENDOR_LATENCY:
+        case ID_DAP_VENDOR_UART_STATS:
+        case ID_DAP_VENDOR_ACK_STATS:
+            expected = 2;
+            break;
+        case ID_DAP_HostStatus:
+        case ID_DAP_Delay:
+        case ID_DAP_SWO_Data:
+            expected = 3;
+            break;
+        case ID_DAP_Vendor31:
+            expected = 4;
+            break;
+        case ID_DAP_SWJ_Clock:
+        case ID_DAP_SWO_Baudrate:
+        case ID_DAP_VENDOR_TARGET_SELECT:
+        case ID_DAP_VENDOR_WAIT_BACKOFF:
+            expected = 5;
+            break;
+        case ID_DAP_TransferConfigure:
+        case ID_DAP_WriteABORT:
+        case ID_DAP_UART_Configure:
+            expected = 6;
+            break;
+        case ID_DAP_SWJ_Pins:
+        case ID_DAP_VENDOR_PC_SAMPLE:
+            expected = 7;
+            break;
+        case ID_DAP_VENDOR_MEM_CRC:
+            expected = 10;
+            break;
+        case ID_DAP_VENDOR_MEM_READ:
+            expected = 11;
+            break;
+        case ID_DAP_VENDOR_WATCH:
+            expected = 12;
+            break;
+        case ID_DAP_VENDOR_RTT:
+            expected = 13;
+            break;
+        case ID_DAP_VENDOR_FLASH_SETUP:
+            expected = 30;
+            break;
+        case ID_DAP_JTAG_Configure:
+            if (len < 2) {
+                return 0;
+            }
+            expected = 2 + request[1];
+            break;
+        case ID_DAP_VENDOR_GANG_SEQUENCE:
+            if (len < 3) {
+                return 0;
+            }
+            bits = request[2] ? request[2] : 256;
+            expected = 3 + (bits + 7) / 8;
+            break;
+        case ID_DAP_TransferBlock:
+            if (len < 5) {
+                return 0;
+            }
+            expected = 5;
+            if (!(request[4] & DAP_TRANSFER_RnW)) {
+                expected += 4 * (request[2] | (request[3] << 8));
+            }
+            break;
+        case ID_DAP_VENDOR_MEM_WRITE:
+            if (len < 9) {
+                return 0;
+            }
+            expected = 9 + (request[7] | (request[8] << 8));
+            break;
+        case ID_DAP_VENDOR_FLASH_PROGRAM:
+            if (len < 7) {
+                return 0;
+            }
+            expected = 7 + (request[5] | (request[6] << 8));
+            break;
+        case ID_DAP_Transfer:
+        case ID_DAP_VENDOR_GANG_TRANSFER:
+            if (len < 3) {
+                return 0;
+            }
+            expected = 3;
+            for (count = request[2]; count > 0; count--) {
+                if (expected >= len) {
+                    return 0;
+                }
+                uint8_t transfer = request[expected++];
+                if (!(transfer & DAP_TRANSFER_RnW) || (transfer & DAP_TRANSFER_MATCH_VALUE)) {
+                    expected += 4;
+                }
+            }
+            break;
+        case ID_DAP_SWJ_Sequence:
+            if (len < 2) {
+                return 0;
+            }
+            bits = request[1] ? request[1] : 256;
+            expected = 2 + (bits + 7) / 8;
+            break;
+        case ID_DAP_SWD_Sequence:
+        case ID_DAP_JTAG_Sequence:
+            if (len < 2) {
+                return 0;
+            }
+            expected = 2;
+            for (count = request[1]; count > 0; count--) {
+                if (expected >= len) {
+                    return 0;
+                }
+                uint8_t info = request[expected++];
+                // SWD input sequences carry no data; JTAG always sends TDI
+                if ((request[0] == ID_DAP_SWD_Sequence) && (info & SWD_SEQUENCE_DIN)) {
+                    continue;
+                }
+                bits = info & JTAG_SEQUENCE_TCK;
+                if (bits == 0) {
+                    bits = 64;
+                }
+                expected += (bits + 7) / 8;
+            }
+            break;
+        case ID_DAP_UART_Transfer:
+            if (len < 5) {
+                return 0;
+            }
+            expected = 5 + (request[3] | (request[4] << 8));
+            break;
+        case ID_DAP_QueueCommands:
+        case ID_DAP_ExecuteCommands:
+            if (len < 2) {
+                return 0;
+            }
+            expected = 2;
+            for (count = request[1]; count > 0; count--) {
+                if (expected >= len) {
+                    return 0;
+                }
+                uint32_t nested = bulk_command_length(&request[expected], len - expected);
+                if ((nested == 0) || (nested == BULK_LENGTH_UNKNOWN)) {
+                    return 0;
+                }
+                expected += nested;
+            }
+            break;
+        default:
+            return BULK_LENGTH_UNKNOWN;
+    }
+
+    return expected;
+}
+
+static bool bulk_request_complete(const uint8_t* request, uint16_t len) {
+    uint32_t expected = bulk_command_length(request, len);
+    if (expected == BULK_LENGTH_UNKNOWN) {
+        return true;
+    }
+
+    return (expected != 0) && (len >= expected);
+}
+
+// Each USB packet is read directly after the part of the request received so far
+static uint8_t* get_bulk_report_buffer(uint16_t* len) {
+    *len = DAP_PACKET_SIZE - bulk_rx_len;
+    return (uint8_t*)&buffers[inbox_tail].request[bulk_rx_len];
+}
+
 static bool on_receive_bulk_report(uint8_t* data, uint16_t len) {
-    memcpy((void*)buffers[inbox_tail].data, (const void*)data, len);
-    buffers[inbox_tail].buffer_kind = BUFFER_KIND_BULK;
-    buffers[inbox_tail].size = len;
+    volatile struct usb_buffer* buffer = &buffers[inbox_tail];
+
+    (void)data;
+    bulk_rx_len += len;
+
+    if ((len == USB_BULK_MAX_PACKET_SIZE) && (bulk_rx_len < DAP_PACKET_SIZE) &&
+        !bulk_request_complete((const uint8_t*)buffer->request, bulk_rx_len)) {
+        // More packets to come
+        return true;
+    }
+
+    if (bulk_rx_len == 0) {
+        // Stray zero-length packet
+        return true;
+    }
+
+    buffer->buffer_kind = BUFFER_KIND_BULK;
+    buffer->size = bulk_rx_len;
+    bulk_rx_len = 0;
     inbox_tail = (inbox_tail + 1) % DAP_PACKET_QUEUE_SIZE;
+    on_request_queued(buffer);
 
     return ((inbox_tail + 1) % DAP_PACKET_QUEUE_SIZE) != outbox_head;
 }
 
-static void on_send_bulk_report(uint8_t* data, uint16_t* len) {
-    if (outbox_head != process_head && buffers[outbox_head].buffer_kind == BUFFER_KIND_BULK_RESPONSE) {
-        memcpy((void*)data, (const void*)buffers[outbox_head].data,
-               buffers[outbox_head].size);
+// The response at outbox_head is sent in place, so it is only released
+// once the bulk endpoint has finished with it.
+static const uint8_t* on_bulk_report_sent(uint16_t* len) {
+    release_outbox_head();
+
+    if (outbox_head != outbox_tail && buffers[outbox_head].buffer_kind == BUFFER_KIND_BULK_RESPONSE) {
+        on_response_sent(&buffers[outbox_head]);
         *len = buffers[outbox_head].size;
+        return (const uint8_t*)buffers[outbox_head].response;
+    }
 
-        outbox_head = (outbox_head + 1) % DAP_PACKET_QUEUE_SIZE;
-    } else {
-        *len = 0;
+    *len = 0;
+    return NULL;
+}
+#endif
+
+// Latency histogram: request [id, clear], response [id, status, count, count * 32-bit buckets]
+static uint32_t DAP_Latency(const uint8_t* request, uint8_t* response) {
+    uint8_t i;
+
+    response[0] = request[0];
+    response[1] = DAP_OK;
+    response[2] = DAP_LATENCY_BUCKETS;
+    for (i = 0; i < DAP_LATENCY_BUCKETS; i++) {
+        uint32_t count = latency_histogram[i];
+        response[3 + 4*i + 0] = (uint8_t)(count >>  0);
+        response[3 + 4*i + 1] = (uint8_t)(count >>  8);
+        response[3 + 4*i + 2] = (uint8_t)(count >> 16);
+        response[3 + 4*i + 3] = (uint8_t)(count >> 24);
+        if (request[1] & 0x01U) {
+            latency_histogram[i] = 0;
+        }
+    }
+
+    return ((2U << 16) | (3U + 4U * DAP_LATENCY_BUCKETS));
+}
+
+#if (DAP_SWD != 0) && (DAP_SWD_MULTIDROP != 0)
+// Multidrop target selection: request [id, targetsel:4], response [id, ack, dpidr:4]
+static uint32_t DAP_TargetSelect(const uint8_t* request, uint8_t* response) {
+    uint32_t targetsel = ((uint32_t)request[1] <<  0) |
+                         ((uint32_t)request[2] <<  8) |
+                         ((uint32_t)request[3] << 16) |
+                         ((uint32_t)request[4] << 24);
+    uint32_t dpidr = 0U;
+    uint8_t ack = DAP_ERROR;
+
+    if (DAP_Data.debug_port == DAP_PORT_SWD) {
+        // Reading DPIDR completes the selection
+        SWD_TargetSelect(targetsel);
+        ack = SWD_Transfer(DP_IDCODE | DAP_TRANSFER_RnW, &dpidr);
+    }
+
+    response[0] = request[0];
+    response[1] = ack;
+    response[2] = (uint8_t)(dpidr >>  0);
+    response[3] = (uint8_t)(dpidr >>  8);
+    response[4] = (uint8_t)(dpidr >> 16);
+    response[5] = (uint8_t)(dpidr >> 24);
+    return ((5U << 16) | 6U);
+}
+#endif
+
+#if (DAP_SWD != 0)
+// WAIT backoff: request [id, wait_idle:2, wait_idle_max:2], response [id, status]
+static uint32_t DAP_WaitBackoff(const uint8_t* request, uint8_t* response) {
+    DAP_Data.swd_conf.wait_idle = (uint16_t)(((uint32_t)request[1] << 0) |
+                                             ((uint32_t)request[2] << 8));
+    DAP_Data.swd_conf.wait_idle_max = (uint16_t)(((uint32_t)request[3] << 0) |
+                                                 ((uint32_t)request[4] << 8));
+
+    response[0] = request[0];
+    response[1] = DAP_OK;
+    return ((5U << 16) | 2U);
+}
+
+// SWD response counts: request [id, clear], response [id, status, 6 * 32-bit counts]
+static uint32_t DAP_AckStats(const uint8_t* request, uint8_t* response) {
+    uint32_t stats[6];
+    uint8_t i;
+
+    SWD_ReadAckStats(stats, request[1] & 0x01U);
+
+    response[0] = request[0];
+    response[1] = DAP_OK;
+    for (i = 0; i < 6; i++) {
+        response[2 + 4*i + 0] = (uint8_t)(stats[i] >>  0);
+        response[2 + 4*i + 1] = (uint8_t)(stats[i] >>  8);
+        response[2 + 4*i + 2] = (uint8_t)(stats[i] >> 16);
+        response[2 + 4*i + 3] = (uint8_t)(stats[i] >> 24);
     }
+    return ((2U << 16) | 26U);
 }
 #endif
 
 uint32_t DAP_ProcessVendorCommand(const uint8_t* request, uint8_t* response) {
+    if (request[0] == ID_DAP_VENDOR_LATENCY) {
+        return DAP_Latency(request, response);
+    }
+
+#if (DAP_UART != 0)
+    if (request[0] == ID_DAP_VENDOR_UART_STATS) {
+        return UART_Stats(request, response);
+    }
+#endif
+
+#if (DAP_SWD != 0) && (DAP_SWD_MULTIDROP != 0)
+    if (request[0] == ID_DAP_VENDOR_TARGET_SELECT) {
+        return DAP_TargetSelect(request, response);
+    }
+#endif
+
+#if (DAP_SWD != 0)
+
+    if (request[0] == ID_DAP_VENDOR_WAIT_BACKOFF) {
+        return DAP_WaitBackoff(request, response);
+    }
+
+    if (request[0] == ID_DAP_VENDOR_ACK_STATS) {
+        return DAP_AckStats(request, response);
+    }
+#endif
+
+#if (DAP_SWD_GANG != 0)
+    if (request[0] == ID_DAP_VENDOR_GANG_SEQUENCE) {
+        return GANG_Sequence(request, response);
+    }
+
+    if (request[0] == ID_DAP_VENDOR_GANG_TRANSFER) {
+        return GANG_Transfer(request, response);
+    }
+#endif
+
+#if (DAP_MEMORY != 0)
+    // Only a request of its own can be finished over several passes
+    uint32_t resumable = (request == (const uint8_t*)buffers[process_head].request) ? 1U : 0U;
+
+    if (request[0] == ID_DAP_VENDOR_MEM_READ) {
+        return MEM_Read(request, response);
+    }
+
+    if (request[0] == ID_DAP_VENDOR_MEM_WRITE) {
+        return MEM_Write(request, response);
+    }
+
+    if (request[0] == ID_DAP_VENDOR_MEM_CRC) {
+        return MEM_Crc32(request, response, resumable);
+    }
+
+    if (request[0] == ID_DAP_VENDOR_WATCH) {
+        return MEM_Watch(request, response);
+    }
+
+    if (request[0] == ID_DAP_VENDOR_WATCH_EVENT) {
+        return MEM_WatchEvent(request, response);
+    }
+#endif
+
+#if (DAP_FLASH != 0)
+    if (request[0] == ID_DAP_VENDOR_FLASH_SETUP) {
+        return FLASH_Setup(request, response);
+    }
+
+    if (request[0] == ID_DAP_VENDOR_FLASH_PROGRAM) {
+        return FLASH_Program(request, response, resumable);
+    }
+
+    if (request[0] == ID_DAP_VENDOR_FLASH_FINISH) {
+        return FLASH_Finish(request, response, resumable);
+    }
+#endif
+
+#if RTT_AVAILABLE
+    if (request[0] == ID_DAP_VENDOR_RTT) {
+        return RTT_Start(request, response, resumable);
+    }
+#endif
+
+#if PC_SAMPLE_AVAILABLE
+    if (request[0] == ID_DAP_VENDOR_PC_SAMPLE) {
+        return SAMPLE_Start(request, response);
+    }
+#endif
+
     if (request[0] == ID_DAP_Vendor31) {
         if (request[1] == 'D' && request[2] == 'F' && request[3] == 'U') {
             response[0] = request[0];
@@ -135,57 +690,290 @@ uint32_t DAP_ProcessVendorCommand(const uint8_t* request, uint8_t* response) {
     return ((1U << 16) | 1U);
 }
 
+#if (SWO_STREAM != 0)
+// SWO.c queues trace packets here with interrupts masked
+uint32_t SWO_QueueTransfer(uint8_t* buf, uint32_t num) {
+    return bulk_send_trace(buf, num) ? 1U : 0U;
+}
+#endif
+
+#if PC_SAMPLE_AVAILABLE
+// Sample.c sends packed PC samples on the same endpoint as SWO trace
+uint32_t SAMPLE_QueueTransfer(uint8_t* buf, uint32_t num) {
+    return bulk_send_trace(buf, num) ? 1U : 0U;
+}
+#endif
+
 void DAP_app_set_serial_number(const char* serial) {
     DAP_SetSerial(serial);
 }
 
+// The USB reset callback runs from the USB interrupt, which can preempt a
+// command in the middle of updating the queue, so it only flags the reset
+// for DAP_app_process() to carry out.
 static void DAP_app_reset(void) {
-    inbox_tail = 0;
-    process_head = 0;
-    outbox_head = 0;
+    reset_pending = true;
+#if DAP_PENDSV
+    SCB_ICSR = SCB_ICSR_PENDSVSET;
+#endif
+}
+
+static void DAP_app_finish_reset(void) {
+    reset_pending = false;
+    CM_ATOMIC_BLOCK() {
+        inbox_tail = 0;
+        process_head = 0;
+        outbox_head = 0;
+        outbox_tail = 0;
+#if BULK_AVAILABLE
+        bulk_rx_len = 0;
+#endif
+    }
+#if (DAP_MEMORY != 0)
+    MEM_ReadCancel();
+    MEM_Crc32Cancel();
+    MEM_WatchCancel();
+#endif
+#if (DAP_FLASH != 0)
+    FLASH_Cancel();
+#endif
+#if RTT_AVAILABLE
+    RTT_Stop();
+#endif
+#if PC_SAMPLE_AVAILABLE
+    SAMPLE_Reset();
+#endif
     DAP_Setup();
 }
 
-bool DAP_app_update(void) {
-    uint8_t response_buffer[DAP_PACKET_SIZE];
+// Turn a slot's request into its response, ready to be sent
+static void complete_response(volatile struct usb_buffer* buffer, uint32_t response_bytes) {
+    if (response_bytes > DAP_PACKET_SIZE) {
+        DAP_APP_BREAKPOINT(0);
+    }
+    switch (buffer->buffer_kind) {
+#if HID_AVAILABLE
+        case BUFFER_KIND_HID:
+            // Always pad to the full size to avoid issues on Windows
+            if (response_bytes < USB_HID_MAX_PACKET_SIZE) {
+                memset((void *)&buffer->response[response_bytes], 0,
+                       USB_HID_MAX_PACKET_SIZE - response_bytes);
+            }
+            buffer->buffer_kind = BUFFER_KIND_HID_RESPONSE;
+            buffer->size = USB_HID_MAX_PACKET_SIZE;
+            break;
+#endif
+#if BULK_AVAILABLE
+        case BUFFER_KIND_BULK:
+            buffer->buffer_kind = BUFFER_KIND_BULK_RESPONSE;
+            buffer->size = response_bytes;
+            break;
+#endif
+        default:
+            DAP_APP_BREAKPOINT(1);
+    }
+}
+
+#if (DAP_MEMORY != 0)
+// Take the inbox slot for a further packet of a streamed response, once
+// every request has been answered. The slot is taken as if a request of the given
+// kind had arrived, as long as that leaves a slot for the OUT endpoints to
+// receive into.
+static volatile struct usb_buffer* claim_inbox_slot(uint8_t kind) {
+    volatile struct usb_buffer* buffer = NULL;
+
+    CM_ATOMIC_BLOCK() {
+        bool receiving = false;
+#if BULK_AVAILABLE
+        receiving = (bulk_rx_len != 0);
+#endif
+        if (!receiving && (process_head == inbox_tail) &&
+            (((inbox_tail + 2) % DAP_PACKET_QUEUE_SIZE) != outbox_head)) {
+            buffer = &buffers[inbox_tail];
+            buffer->buffer_kind = kind;
+            inbox_tail = (inbox_tail + 1) % DAP_PACKET_QUEUE_SIZE;
+        }
+    }
+
+    if (buffer != NULL) {
+        buffer->timestamp = get_timestamp();
+#if HID_AVAILABLE
+        DAP_SetPacketSize((buffer->buffer_kind == BUFFER_KIND_HID) ?
+                          USB_HID_MAX_PACKET_SIZE : DAP_PACKET_SIZE);
+#endif
+    }
+    return buffer;
+}
+
+// Send the next packet of a memory read
+static bool DAP_app_continue_read(void) {
+    volatile struct usb_buffer* buffer = claim_inbox_slot(request_kind);
+    if (buffer == NULL) {
+        return false;
+    }
+
+    complete_response(buffer, MEM_ReadNext((uint8_t *)buffer->response));
+    process_head = (process_head + 1) % DAP_PACKET_QUEUE_SIZE;
+    outbox_tail = process_head;
+    return true;
+}
+
+// Read the watched register when it's due and every request has been executed
+static bool DAP_app_watch(void) {
+    if ((MEM_WatchDue() == 0U) || (process_head != inbox_tail)) {
+        return false;
+    }
+    MEM_WatchPoll();
+    return true;
+}
+#endif
+
+// Whether the command at process_head still holds its slot
+static bool command_pending(void) {
+#if RTT_AVAILABLE
+    if (RTT_Pending() != 0U) {
+        return true;
+    }
+#endif
+#if (DAP_MEMORY != 0)
+    if (MEM_Crc32Pending() != 0U) {
+        return true;
+    }
+#endif
+#if (DAP_FLASH != 0)
+    if (FLASH_Pending() != 0U) {
+        return true;
+    }
+#endif
+    return false;
+}
+
+// Take the next step of the pending command
+//   return: number of bytes left to process
+static uint32_t command_next(uint8_t* response) {
+#if RTT_AVAILABLE
+    if (RTT_Pending() != 0U) {
+        return RTT_Next(response);
+    }
+#endif
+#if (DAP_MEMORY != 0)
+    if (MEM_Crc32Pending() != 0U) {
+        return MEM_Crc32Next(response);
+    }
+#endif
+#if (DAP_FLASH != 0)
+    if (FLASH_Pending() != 0U) {
+        return FLASH_Next(response);
+    }
+#endif
+    (void)response;
+    return 0U;
+}
+
+#if RTT_AVAILABLE
+// Poll the RTT channel when it's due and every request has been executed
+static bool DAP_app_rtt(void) {
+    if ((RTT_Due() == 0U) || (process_head != inbox_tail)) {
+        return false;
+    }
+    RTT_Poll();
+    return true;
+}
+#endif
+
+#if PC_SAMPLE_AVAILABLE
+// Sample the target's PC when it's due and every request has been executed
+static bool DAP_app_sample(void) {
+    if ((SAMPLE_Due() == 0U) || (process_head != inbox_tail)) {
+        return false;
+    }
+    SAMPLE_Poll();
+    return true;
+}
+#endif
+
+// Hand the response at process_head over to the outbox
+static void finish_request(volatile struct usb_buffer* buffer, uint32_t response_bytes, bool queued) {
+    complete_response(buffer, response_bytes);
+    process_head = (process_head + 1) % DAP_PACKET_QUEUE_SIZE;
+
+    // Hold the responses to queued commands until a request that isn't
+    // queued arrives, unless every slot is already taken by them and the
+    // host couldn't send that request.
+    bool ring_full = ((inbox_tail + 1) % DAP_PACKET_QUEUE_SIZE) == outbox_head;
+    if (!queued || (ring_full && (process_head == inbox_tail))) {
+        outbox_tail = process_head;
+    }
+}
+
+// Execute the next queued command and start sending any finished response
+static bool DAP_app_process(void) {
     bool active = false;
 
-    if (process_head != inbox_tail) {
-        memset(response_buffer, 0, DAP_PACKET_SIZE);
-        uint32_t result = DAP_ExecuteCommand((const uint8_t *)buffers[process_head].data,
-                                             response_buffer);
-        uint32_t response_bytes = result & 0xffff;
-        if (response_bytes > DAP_PACKET_SIZE) {
-            asm("bkpt #0");
+    if (reset_pending) {
+        DAP_app_finish_reset();
+        return true;
+    }
+
+    if (command_pending()) {
+        // A long command holds its slot, and the requests behind it, until
+        // it's done
+        volatile struct usb_buffer* buffer = &buffers[process_head];
+        uint8_t* response = (uint8_t *)buffer->response;
+        if (command_next(response) == 0U) {
+            finish_request(buffer, pending_response_bytes, false);
         }
-        memcpy((void *)buffers[process_head].data, response_buffer, response_bytes);
-        switch (buffers[process_head].buffer_kind) {
+        active = true;
+    } else if (process_head != inbox_tail) {
+        volatile struct usb_buffer* buffer = &buffers[process_head];
 #if HID_AVAILABLE
-            case BUFFER_KIND_HID:
-                // Always pad to the full size to avoid issues on Windows
-                buffers[process_head].buffer_kind = BUFFER_KIND_HID_RESPONSE;
-                buffers[process_head].size = DAP_PACKET_SIZE;
-                break;
+        DAP_SetPacketSize((buffer->buffer_kind == BUFFER_KIND_HID) ?
+                          USB_HID_MAX_PACKET_SIZE : DAP_PACKET_SIZE);
 #endif
-#if BULK_AVAILABLE
-            case BUFFER_KIND_BULK:
-                buffers[process_head].buffer_kind = BUFFER_KIND_BULK_RESPONSE;
-                buffers[process_head].size = response_bytes;
-                break;
+        bool queued = (buffer->request[0] == ID_DAP_QueueCommands);
+#if PC_SAMPLE_AVAILABLE
+        // The host expects CSW and TAR as it left them
+        SAMPLE_Release();
+#endif
+        uint32_t result = DAP_ExecuteCommand((const uint8_t *)buffer->request,
+                                             (uint8_t *)buffer->response);
+        // Any other request ends a streamed memory read early. A read
+        // nested in DAP_ExecuteCommands only answers with its first packet.
+        request_kind = buffer->buffer_kind;
+#if (DAP_MEMORY != 0)
+        if (buffer->request[0] != ID_DAP_VENDOR_MEM_READ) {
+            MEM_ReadCancel();
+        }
 #endif
-            default:
-                asm("bkpt #1");
+        if (command_pending()) {
+            pending_response_bytes = (uint16_t)(result & 0xffff);
+        } else {
+            finish_request(buffer, result & 0xffff, queued);
         }
-        process_head = (process_head + 1) % DAP_PACKET_QUEUE_SIZE;
         active = true;
+#if (DAP_MEMORY != 0)
+    } else if (MEM_ReadPending() != 0U) {
+        active = DAP_app_continue_read();
+#endif
+    } else {
+#if (DAP_MEMORY != 0)
+        active = DAP_app_watch();
+#endif
+#if RTT_AVAILABLE
+        active = DAP_app_rtt() || active;
+#endif
+#if PC_SAMPLE_AVAILABLE
+        active = DAP_app_sample() || active;
+#endif
     }
 
 #if HID_AVAILABLE
     if (hid_get_in_ep_idle() &&
-        (outbox_head != process_head) &&
+        (outbox_head != outbox_tail) &&
         (buffers[outbox_head].buffer_kind == BUFFER_KIND_HID_RESPONSE)) {
-        if (hid_send_report((const uint8_t*)buffers[outbox_head].data, buffers[outbox_head].size)) {
-            outbox_head = (outbox_head + 1) % DAP_PACKET_QUEUE_SIZE;
+        // outbox_head advances in on_hid_report_sent()
+        if (hid_send_report((const uint8_t*)buffers[outbox_head].response, buffers[outbox_head].size)) {
+            on_response_sent(&buffers[outbox_head]);
             active = true;
         }
     }
@@ -193,10 +981,11 @@ bool DAP_app_update(void) {
 
 #if BULK_AVAILABLE
     if (bulk_get_in_ep_idle() &&
-        (outbox_head != process_head) &&
+        (outbox_head != outbox_tail) &&
         (buffers[outbox_head].buffer_kind == BUFFER_KIND_BULK_RESPONSE)) {
-        if (bulk_send_report((const uint8_t*)buffers[outbox_head].data, buffers[outbox_head].size)) {
-            outbox_head = (outbox_head + 1) % DAP_PACKET_QUEUE_SIZE;
+        // outbox_head advances in on_bulk_report_sent()
+        if (bulk_send_report((const uint8_t*)buffers[outbox_head].response, buffers[outbox_head].size)) {
+            on_response_sent(&buffers[outbox_head]);
             active = true;
         }
     }
@@ -205,15 +994,67 @@ bool DAP_app_update(void) {
     return active;
 }
 
+#if DAP_PENDSV
+// Commands are executed from the lowest priority interrupt, pended whenever a
+// request arrives, so that the other apps in the main loop cannot delay them
+// while USB interrupts can still preempt a long running command. Each PendSV
+// does one step of work; pending it again from the handler would tail-chain
+// straight back in, so DAP_app_update() pends it again from the main loop,
+// which keeps the watchdog fed while a long queue is worked through.
+void pend_sv_handler(void) {
+    if (DAP_app_process()) {
+        pendsv_active = true;
+    }
+}
+#endif
+
+bool DAP_app_update(void) {
+#if (SWO_STREAM != 0)
+    // Pick up trace that trickles in below the RX DMA's half buffer interrupt
+    SWO_Process();
+#endif
+#if DAP_PENDSV
+    // Commands run from PendSV; just report whether it did anything
+    bool due = reset_pending || command_pending() || (process_head != inbox_tail);
+#if (DAP_MEMORY != 0)
+    due = due || (MEM_ReadPending() != 0U) || (MEM_WatchDue() != 0U);
+#endif
+#if RTT_AVAILABLE
+    due = due || (RTT_Due() != 0U);
+#endif
+#if PC_SAMPLE_AVAILABLE
+    due = due || (SAMPLE_Due() != 0U);
+#endif
+    if (due) {
+        SCB_ICSR = SCB_ICSR_PENDSVSET;
+    }
+    bool active = pendsv_active;
+    pendsv_active = false;
+    return active;
+#else
+    return DAP_app_process();
+#endif
+}
+
 void DAP_app_setup(usbd_device* usbd_dev, GenericCallback on_dfu_request) {
     DAP_Setup();
 #if HID_AVAILABLE
-    hid_setup(usbd_dev, on_send_hid_report, on_receive_hid_report);
+    hid_setup(usbd_dev, on_hid_report_sent, get_hid_report_buffer, on_receive_hid_report);
 #endif
 #if BULK_AVAILABLE
-    bulk_setup(usbd_dev, on_send_bulk_report, on_receive_bulk_report);
+    bulk_setup(usbd_dev, DAP_PACKET_SIZE, on_bulk_report_sent, get_bulk_report_buffer,
+               on_receive_bulk_report);
+#endif
+#if (SWO_STREAM != 0)
+    bulk_set_trace_callback(SWO_TransferComplete);
 #endif
     dfu_request_callback = on_dfu_request;
 
     cmp_usb_register_reset_callback(DAP_app_reset);
+
+#if DAP_PENDSV
+    // Run PendSV below every other interrupt. ARMv6-M only allows word
+    // access to the system handler priority registers.
+    SCB_SHPR3 |= (0xFFU << 16);
+#endif
 }
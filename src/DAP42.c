@@ -34,6 +34,7 @@
 
 #include "DAP/app.h"
 #include "DAP/CMSIS_DAP_hal.h"
+#include "DAP/CMSIS_DAP.h"
 #include "DFU/DFU.h"
 
 #include "CAN/slcan.h"
@@ -139,6 +140,9 @@ int main(void) {
 
     tick_start();
 
+    /* Measure the SWJ clock against SysTick before any debugger connects */
+    DAP_CalibrateClock();
+
     /* Enable the watchdog to enable DFU recovery from bad firmware images */
     iwdg_set_period_ms(1000);
     iwdg_start();
@@ -153,7 +157,8 @@ int main(void) {
             cdc_uart_app_update();
         }
 
-        if (CAN_RX_AVAILABLE && VCDC_AVAILABLE) {
+        // An RTT channel takes the virtual CDC port over from slcan
+        if (CAN_RX_AVAILABLE && VCDC_AVAILABLE && !(RTT_AVAILABLE && RTT_Active())) {
             slcan_app_update();
         }
 
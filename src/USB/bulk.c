@@ -28,42 +28,125 @@
 
 /* User callbacks */
 static HostOutFunction bulk_out_callback = NULL;
-static HostInFunction bulk_in_callback = NULL;
+static HostBufferFunction bulk_buffer_callback = NULL;
+static HostReportFunction bulk_in_callback = NULL;
 
 static usbd_device *bulk_usbd_dev = NULL;
 static volatile bool bulk_in_ep_idle = true;
+static volatile bool bulk_out_paused = false;
+
+#if SWO_STREAM_AVAILABLE
+static GenericCallback bulk_trace_callback = NULL;
+static volatile bool bulk_trace_ep_idle = true;
+#endif
+
+/* Report currently being sent */
+static uint16_t bulk_report_size = USB_BULK_MAX_PACKET_SIZE;
+static const uint8_t* bulk_tx_data = NULL;
+static uint16_t bulk_tx_len = 0;
+static bool bulk_tx_zlp = false;
+
+/* Queue the next packet of the current report */
+static uint16_t bulk_write_next(usbd_device *usbd_dev)
+{
+    uint16_t len = bulk_tx_len;
+    if (len > USB_BULK_MAX_PACKET_SIZE) {
+        len = USB_BULK_MAX_PACKET_SIZE;
+    }
+
+    uint16_t sent = usbd_ep_write_packet(usbd_dev, ENDP_BULK_IN, bulk_tx_data, len);
+    if (sent == len) {
+        bulk_tx_data += len;
+        bulk_tx_len -= len;
+        if (len < USB_BULK_MAX_PACKET_SIZE) {
+            // A short packet ends the transfer
+            bulk_tx_zlp = false;
+        }
+    }
+    return sent;
+}
+
+static bool bulk_start_report(usbd_device *usbd_dev, const uint8_t* report, uint16_t len)
+{
+    bulk_tx_data = report;
+    bulk_tx_len = len;
+    // The host reads up to report_size bytes, so anything shorter that ends
+    // on a packet boundary needs a zero-length packet to terminate it.
+    bulk_tx_zlp = (len < bulk_report_size);
+    return bulk_write_next(usbd_dev) != 0;
+}
 
 /* Handle sending additional data to the host */
 static void bulk_in(usbd_device *usbd_dev, uint8_t ep)
 {
-    if (bulk_in_callback != NULL)
-    {
-        uint8_t buf[USB_BULK_MAX_PACKET_SIZE];
-        uint16_t len = 0;
-        bulk_in_callback(buf, &len);
-        if (len > 0) {
-            usbd_ep_write_packet(usbd_dev, ep, (const void*)buf, len);
-            bulk_in_ep_idle = false;
-        } else {
-            // No data ready to transmit now; we will not receive another
-            // interrupt until someone manually sends data via bulk_send_report()
-            bulk_in_ep_idle = true;
-        }
+    (void)ep;
+
+    if (bulk_tx_len > 0 || bulk_tx_zlp) {
+        bulk_write_next(usbd_dev);
+        return;
+    }
+
+    const uint8_t* report = NULL;
+    uint16_t len = 0;
+    if (bulk_in_callback != NULL) {
+        report = bulk_in_callback(&len);
+    }
+
+    if (report != NULL && len > 0) {
+        bulk_start_report(usbd_dev, report, len);
+        bulk_in_ep_idle = false;
+    } else {
+        // No data ready to transmit now; we will not receive another
+        // interrupt until someone manually sends data via bulk_send_report()
+        bulk_in_ep_idle = true;
     }
 }
 
 /* Receive data from the host */
 static void bulk_out(usbd_device *usbd_dev, uint8_t ep)
 {
-    uint8_t buf[USB_BULK_MAX_PACKET_SIZE];
-    uint16_t len = usbd_ep_read_packet(usbd_dev, ep, (void *)buf, sizeof(buf));
-    // TODO: set NAK for flow control if the callback indicates it isn't ready
-    // to accept more packets.
-    if (len > 0 && (bulk_out_callback != NULL))
+    // Keep NAKing the host until we know there is room for another packet
+    usbd_ep_nak_set(usbd_dev, ep, 1);
+
+    // Read straight into the caller's buffer, if it has one
+    uint8_t* buf = NULL;
+    uint16_t capacity = 0;
+    if (bulk_buffer_callback != NULL) {
+        buf = bulk_buffer_callback(&capacity);
+    }
+    if (buf == NULL) {
+        capacity = 0;
+    }
+
+    uint16_t len = usbd_ep_read_packet(usbd_dev, ep, (void *)buf, capacity);
+    bool ready = true;
+    // Zero-length packets are passed on, since they can terminate a request
+    if ((buf != NULL) && (bulk_out_callback != NULL))
     {
-        bulk_out_callback(buf, len);
+        ready = bulk_out_callback(buf, len);
+    }
+
+    if (ready) {
+        usbd_ep_nak_set(usbd_dev, ep, 0);
+    } else {
+        // Wait for bulk_resume_out()
+        bulk_out_paused = true;
+    }
+}
+
+#if SWO_STREAM_AVAILABLE
+/* Trace data is a plain byte stream, sent one packet at a time */
+static void bulk_trace_in(usbd_device *usbd_dev, uint8_t ep)
+{
+    (void)usbd_dev;
+    (void)ep;
+
+    bulk_trace_ep_idle = true;
+    if (bulk_trace_callback != NULL) {
+        bulk_trace_callback();
     }
 }
+#endif
 
 static void bulk_set_config(usbd_device *usbd_dev, uint16_t wValue)
 {
@@ -76,25 +159,39 @@ static void bulk_set_config(usbd_device *usbd_dev, uint16_t wValue)
     // IN (device-to-host)
     usbd_ep_setup(usbd_dev, ENDP_BULK_IN, USB_ENDPOINT_ATTR_BULK, 64,
                   bulk_in);
+
+#if SWO_STREAM_AVAILABLE
+    // IN (SWO trace)
+    usbd_ep_setup(usbd_dev, ENDP_BULK_IN_SWO, USB_ENDPOINT_ATTR_BULK, 64,
+                  bulk_trace_in);
+    bulk_trace_ep_idle = true;
+#endif
+
+    // Any report in flight was lost with the bus reset
+    bulk_tx_len = 0;
+    bulk_tx_zlp = false;
+    bulk_in_ep_idle = true;
+    bulk_out_paused = false;
+    usbd_ep_nak_set(usbd_dev, ENDP_BULK_OUT, 0);
 }
 
 void bulk_setup(usbd_device *usbd_dev,
-                HostInFunction report_send_cb,
+                uint16_t report_size,
+                HostReportFunction report_sent_cb,
+                HostBufferFunction report_buffer_cb,
                 HostOutFunction report_recv_cb)
 {
     bulk_usbd_dev = usbd_dev;
-    bulk_in_callback = report_send_cb;
+    bulk_report_size = report_size;
+    bulk_in_callback = report_sent_cb;
+    bulk_buffer_callback = report_buffer_cb;
     bulk_out_callback = report_recv_cb;
 
     cmp_usb_register_set_config_callback(bulk_set_config);
 }
 
 bool bulk_send_report(const uint8_t* report, size_t len) {
-    uint16_t sent = usbd_ep_write_packet(bulk_usbd_dev,
-                                         ENDP_BULK_IN,
-                                         report,
-                                         (uint16_t)len);
-    if (sent != 0) {
+    if (bulk_start_report(bulk_usbd_dev, report, (uint16_t)len)) {
         // The data is ready to transmit and will eventually generate an interrupt
         bulk_in_ep_idle = false;
         return true;
@@ -107,4 +204,34 @@ bool bulk_get_in_ep_idle(void) {
     return bulk_in_ep_idle;
 }
 
+void bulk_resume_out(void) {
+    if (bulk_out_paused) {
+        bulk_out_paused = false;
+        usbd_ep_nak_set(bulk_usbd_dev, ENDP_BULK_OUT, 0);
+    }
+}
+
+#if SWO_STREAM_AVAILABLE
+void bulk_set_trace_callback(GenericCallback trace_sent_cb) {
+    bulk_trace_callback = trace_sent_cb;
+}
+
+bool bulk_send_trace(const uint8_t* data, size_t len) {
+    if (!bulk_trace_ep_idle || !cmp_usb_configured()) {
+        return false;
+    }
+
+    bulk_trace_ep_idle = false;
+    if (usbd_ep_write_packet(bulk_usbd_dev, ENDP_BULK_IN_SWO, data, (uint16_t)len) != len) {
+        bulk_trace_ep_idle = true;
+        return false;
+    }
+    return true;
+}
+
+bool bulk_get_trace_ep_idle(void) {
+    return bulk_trace_ep_idle;
+}
+#endif
+
 #endif
@@ -22,9 +22,24 @@
 #include "usb_common.h"
 
 void bulk_setup(usbd_device *usbd_dev,
-                HostInFunction report_send_cb,
+                uint16_t report_size,
+                HostReportFunction report_sent_cb,
+                HostBufferFunction report_buffer_cb,
                 HostOutFunction report_recv_cb);
+/* Start sending a report while the IN endpoint is idle. The report is
+ * read in place, so it must stay unmodified until report_sent_cb is called. */
 bool bulk_send_report(const uint8_t* report, size_t len);
 bool bulk_get_in_ep_idle(void);
+/* Accept packets from the host again after report_recv_cb returned false */
+void bulk_resume_out(void);
+
+#if SWO_STREAM_AVAILABLE
+/* Send up to one packet of SWO trace data, or a zero-length packet, while
+ * the trace endpoint is idle. The data is copied before this returns.
+ * trace_sent_cb is called from the USB interrupt once it has been sent. */
+void bulk_set_trace_callback(GenericCallback trace_sent_cb);
+bool bulk_send_trace(const uint8_t* data, size_t len);
+bool bulk_get_trace_ep_idle(void);
+#endif
 
 #endif
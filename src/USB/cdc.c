@@ -302,6 +302,11 @@ static bool cdc_uart_get_line_coding(struct usb_cdc_line_coding* line_coding) {
 }
 
 static bool cdc_uart_on_host_tx(uint8_t* data, uint16_t len) {
+    // Drop host data while the USART is claimed by someone else
+    if (!console_bridge_attached()) {
+        return true;
+    }
+
     console_send_buffered(data, (size_t)len);
     if (cdc_uart_rx_callback) {
         cdc_uart_rx_callback();
@@ -340,49 +345,71 @@ void cdc_uart_app_set_timeout(uint32_t timeout_ms) {
     packet_timeout = timeout_ms;
 }
 
-static bool transfer_complete = false;
-static void cdc_start_in_transfer(void) {
-    transfer_complete = false;
-    if (packet_len < USB_CDC_MAX_PACKET_SIZE) {
-        uint16_t max_bytes = (USB_CDC_MAX_PACKET_SIZE- packet_len);
-        packet_len += console_recv_buffered(&packet_buffer[packet_len], max_bytes);
-    }
-
-    if (packet_len > 0) {
-        if (cdc_send_data(packet_buffer, packet_len)) {
-            transfer_complete = (packet_len < USB_CDC_MAX_PACKET_SIZE);
-            packet_len = console_recv_buffered(packet_buffer, USB_CDC_MAX_PACKET_SIZE);
-            if (cdc_uart_tx_callback) {
-                cdc_uart_tx_callback();
-            }
+/* Send the next packet of USART data to the host, straight out of the
+ * console's DMA buffer. Only a packet that straddles the end of the buffer
+ * is gathered into packet_buffer first; it stays there until it is sent.
+ * An empty packet is sent when there is no data. Returns false without
+ * consuming anything if the endpoint is still busy. */
+static bool cdc_uart_send_packet(uint16_t* sent) {
+    const uint8_t* data = packet_buffer;
+    uint16_t len = packet_len;
+
+    // USART data belongs to whoever has claimed it from the bridge
+    if ((len == 0) && console_bridge_attached()) {
+        data = console_recv_peek(&len);
+        if (len > USB_CDC_MAX_PACKET_SIZE) {
+            len = USB_CDC_MAX_PACKET_SIZE;
+        } else if ((data != NULL) && (len < USB_CDC_MAX_PACKET_SIZE) &&
+                   (console_recv_buffer_level() > len)) {
+            packet_len = (uint16_t)console_recv_buffered(packet_buffer, USB_CDC_MAX_PACKET_SIZE);
+            data = packet_buffer;
+            len = packet_len;
         }
-    } else {
-        transfer_complete = true;
     }
-}
 
-static void cdc_bulk_data_in(usbd_device *usbd_dev, uint8_t ep) {
-    (void)usbd_dev;
-    (void)ep;
-
-    if (packet_len < USB_CDC_MAX_PACKET_SIZE) {
-        uint16_t max_bytes = (USB_CDC_MAX_PACKET_SIZE- packet_len);
-        packet_len += console_recv_buffered(&packet_buffer[packet_len], max_bytes);
+    // The packet is copied into USB packet memory when queued
+    if (!cdc_send_data(data, len)) {
+        return false;
     }
 
-    if (!transfer_complete) {
-        cdc_send_data(packet_buffer, packet_len);
-        if (packet_len < USB_CDC_MAX_PACKET_SIZE) {
-            transfer_complete = true;
-        }
+    if (data == packet_buffer) {
         packet_len = 0;
+    } else {
+        console_recv_skip(len);
+    }
+    *sent = len;
+    return true;
+}
 
+static void cdc_uart_send_next(void) {
+    uint16_t sent = 0;
+    if (cdc_uart_send_packet(&sent)) {
+        // Keep the transfer going until a short packet ends it
+        need_zlp = (sent == USB_CDC_MAX_PACKET_SIZE);
         if (cdc_uart_tx_callback) {
             cdc_uart_tx_callback();
         }
     }
 }
 
+/* Start a transfer on each SOF with whatever data has arrived */
+static void cdc_start_in_transfer(void) {
+    bool pending = (packet_len > 0) ||
+                   (console_bridge_attached() && (console_recv_buffer_level() > 0));
+    if (pending) {
+        cdc_uart_send_next();
+    }
+}
+
+static void cdc_bulk_data_in(usbd_device *usbd_dev, uint8_t ep) {
+    (void)usbd_dev;
+    (void)ep;
+
+    if (need_zlp) {
+        cdc_uart_send_next();
+    }
+}
+
 bool cdc_uart_app_update() {
     bool active = false;
 
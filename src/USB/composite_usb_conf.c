@@ -53,7 +53,9 @@ _Static_assert((1 + NUM_OUT_ENDPOINTS <= 8), "Too many OUT endpoints for USB cor
 #define HID_PMA_USAGE 0
 #endif
 
-#if BULK_AVAILABLE
+#if BULK_AVAILABLE && SWO_STREAM_AVAILABLE
+#define BULK_PMA_USAGE (3*USB_BULK_MAX_PACKET_SIZE)
+#elif BULK_AVAILABLE
 #define BULK_PMA_USAGE (2*USB_BULK_MAX_PACKET_SIZE)
 #else
 #define BULK_PMA_USAGE 0
@@ -344,7 +346,8 @@ static const struct usb_interface_descriptor bulk_iface = {
     .bDescriptorType = USB_DT_INTERFACE,
     .bInterfaceNumber = INTF_BULK,
     .bAlternateSetting = 0,
-    .bNumEndpoints = 2,
+    // The SWO trace endpoint is last so that it can be left out
+    .bNumEndpoints = SWO_STREAM_AVAILABLE ? 3 : 2,
     .bInterfaceClass = USB_CLASS_VENDOR,
     .bInterfaceSubClass = 0,
     .bInterfaceProtocol = 0,
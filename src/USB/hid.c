@@ -65,10 +65,12 @@ const struct full_usb_hid_descriptor hid_function = {
 
 /* User callbacks */
 static HostOutFunction hid_report_out_callback = NULL;
-static HostInFunction hid_report_in_callback = NULL;
+static HostBufferFunction hid_report_buffer_callback = NULL;
+static HostReportFunction hid_report_in_callback = NULL;
 
 static usbd_device* hid_usbd_dev = NULL;
 static volatile bool hid_in_ep_idle = true;
+static volatile bool hid_out_paused = false;
 
 static enum usbd_request_return_codes
 hid_control_standard_request(usbd_device *usbd_dev,
@@ -155,11 +157,10 @@ hid_control_class_request(usbd_device *usbd_dev,
  * start sending another report to the host */
 static void hid_interrupt_in(usbd_device *usbd_dev, uint8_t ep) {
     if (hid_report_in_callback != NULL) {
-        uint8_t buf[USB_HID_MAX_PACKET_SIZE];
         uint16_t len = 0;
-        hid_report_in_callback(buf, &len);
-        if (len > 0) {
-            usbd_ep_write_packet(usbd_dev, ep, (const void*)buf, len);
+        const uint8_t* report = hid_report_in_callback(&len);
+        if (report != NULL && len > 0) {
+            usbd_ep_write_packet(usbd_dev, ep, (const void*)report, len);
             hid_in_ep_idle = false;
         } else {
             // No data ready to transmit now; we will not receive another
@@ -171,12 +172,30 @@ static void hid_interrupt_in(usbd_device *usbd_dev, uint8_t ep) {
 
 /* Receive data from the host */
 static void hid_interrupt_out(usbd_device *usbd_dev, uint8_t ep) {
-    uint8_t buf[USB_HID_MAX_PACKET_SIZE];
-    uint16_t len = usbd_ep_read_packet(usbd_dev, ep, (void*)buf, sizeof(buf));
-    // TODO: set NAK for flow control if the callback indicates it isn't ready
-    // to accept more packets.
-    if (len > 0 && (hid_report_out_callback != NULL)) {
-        hid_report_out_callback(buf, len);
+    // Keep NAKing the host until we know there is room for another report
+    usbd_ep_nak_set(usbd_dev, ep, 1);
+
+    // Read straight into the caller's buffer, if it has one
+    uint8_t* buf = NULL;
+    uint16_t capacity = 0;
+    if (hid_report_buffer_callback != NULL) {
+        buf = hid_report_buffer_callback(&capacity);
+    }
+    if (buf == NULL) {
+        capacity = 0;
+    }
+
+    uint16_t len = usbd_ep_read_packet(usbd_dev, ep, (void*)buf, capacity);
+    bool ready = true;
+    if (len > 0 && (buf != NULL) && (hid_report_out_callback != NULL)) {
+        ready = hid_report_out_callback(buf, len);
+    }
+
+    if (ready) {
+        usbd_ep_nak_set(usbd_dev, ep, 0);
+    } else {
+        // Wait for hid_resume_out()
+        hid_out_paused = true;
     }
 }
 
@@ -187,6 +206,8 @@ static void hid_set_config(usbd_device* usbd_dev, uint16_t wValue) {
                   hid_interrupt_out);
     usbd_ep_setup(usbd_dev, ENDP_HID_REPORT_IN, USB_ENDPOINT_ATTR_INTERRUPT, 64,
                   hid_interrupt_in);
+    hid_out_paused = false;
+    usbd_ep_nak_set(usbd_dev, ENDP_HID_REPORT_OUT, 0);
     usbd_register_control_callback(
         usbd_dev,
         USB_REQ_TYPE_STANDARD | USB_REQ_TYPE_INTERFACE,
@@ -215,11 +236,20 @@ bool hid_get_in_ep_idle(void) {
     return hid_in_ep_idle;
 }
 
+void hid_resume_out(void) {
+    if (hid_out_paused) {
+        hid_out_paused = false;
+        usbd_ep_nak_set(hid_usbd_dev, ENDP_HID_REPORT_OUT, 0);
+    }
+}
+
 void hid_setup(usbd_device* usbd_dev,
-               HostInFunction report_send_cb,
+               HostReportFunction report_sent_cb,
+               HostBufferFunction report_buffer_cb,
                HostOutFunction report_recv_cb) {
     hid_usbd_dev = usbd_dev;
-    hid_report_in_callback = report_send_cb;
+    hid_report_in_callback = report_sent_cb;
+    hid_report_buffer_callback = report_buffer_cb;
     hid_report_out_callback = report_recv_cb;
 
     cmp_usb_register_set_config_callback(hid_set_config);
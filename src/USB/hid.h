@@ -25,10 +25,14 @@
 extern const struct full_usb_hid_descriptor hid_function;
 
 void hid_setup(usbd_device* usbd_dev,
-               HostInFunction report_send_cb,
+               HostReportFunction report_sent_cb,
+               HostBufferFunction report_buffer_cb,
                HostOutFunction report_recv_cb);
 
+/* Start sending a report while the IN endpoint is idle */
 bool hid_send_report(const uint8_t* report, size_t len);
 bool hid_get_in_ep_idle(void);
+/* Accept reports from the host again after report_recv_cb returned false */
+void hid_resume_out(void);
 
 #endif
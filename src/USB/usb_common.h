@@ -26,6 +26,14 @@
 
 typedef void (*GenericCallback)(void);
 typedef bool (*HostOutFunction)(uint8_t* data, uint16_t len);
-typedef void (*HostInFunction)(uint8_t* data, uint16_t* len);
+
+/* Returns the buffer that the next packet from the host is read into and
+ * sets len to its capacity, or returns NULL to drop the packet. */
+typedef uint8_t* (*HostBufferFunction)(uint16_t* len);
+
+/* Called once the previous report has been sent. Returns the next report to
+ * send, or NULL if none is ready. The report is read in place and must stay
+ * unmodified until the callback is called again. */
+typedef const uint8_t* (*HostReportFunction)(uint16_t* len);
 
 #endif
@@ -16,6 +16,7 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/usb/usbd.h>
 #include <libopencm3/usb/cdc.h>
 #include "composite_usb_conf.h"
@@ -116,10 +117,17 @@ static uint8_t vcdc_rx_buffer_get(void) {
     return data;
 }
 
+/*
+ * The buffers are also filled and drained from the DAP app, which may run
+ * from PendSV and preempt the main loop, so the indices are only updated
+ * with interrupts masked.
+ */
 size_t vcdc_recv_buffered(uint8_t* data, size_t max_bytes) {
     size_t bytes_read = 0;
-    while (!vcdc_rx_buffer_empty() && (bytes_read < max_bytes)) {
-        data[bytes_read++] = vcdc_rx_buffer_get();
+    CM_ATOMIC_BLOCK() {
+        while (!vcdc_rx_buffer_empty() && (bytes_read < max_bytes)) {
+            data[bytes_read++] = vcdc_rx_buffer_get();
+        }
     }
 
     return bytes_read;
@@ -127,8 +135,10 @@ size_t vcdc_recv_buffered(uint8_t* data, size_t max_bytes) {
 
 size_t vcdc_send_buffered(const uint8_t* data, size_t num_bytes) {
     size_t bytes_queued = 0;
-    while (!vcdc_tx_buffer_full() && bytes_queued < num_bytes) {
-        vcdc_tx_buffer_put(data[bytes_queued++]);
+    CM_ATOMIC_BLOCK() {
+        while (!vcdc_tx_buffer_full() && bytes_queued < num_bytes) {
+            vcdc_tx_buffer_put(data[bytes_queued++]);
+        }
     }
 
     return bytes_queued;
@@ -245,9 +255,11 @@ void vcdc_app_setup(usbd_device* usbd_dev,
 bool vcdc_app_update(void) {
     bool active = false;
 
-    while (packet_len < USB_VCDC_MAX_PACKET_SIZE && !vcdc_tx_buffer_empty()) {
-        packet_buffer[packet_len] = vcdc_tx_buffer_get();
-        packet_len++;
+    CM_ATOMIC_BLOCK() {
+        while (packet_len < USB_VCDC_MAX_PACKET_SIZE && !vcdc_tx_buffer_empty()) {
+            packet_buffer[packet_len] = vcdc_tx_buffer_get();
+            packet_len++;
+        }
     }
 
     if (packet_len > 0 && cmp_usb_configured()) {
@@ -268,8 +280,10 @@ bool vcdc_app_update(void) {
 }
 
 void vcdc_putchar(const char c) {
-    if (!vcdc_tx_buffer_full()) {
-        vcdc_tx_buffer_put(c);
+    CM_ATOMIC_BLOCK() {
+        if (!vcdc_tx_buffer_full()) {
+            vcdc_tx_buffer_put(c);
+        }
     }
 }
 
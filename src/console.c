@@ -16,6 +16,9 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <string.h>
+
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/cm3/nvic.h>
 #include <libopencm3/stm32/dma.h>
 #include <libopencm3/stm32/rcc.h>
@@ -23,6 +26,11 @@
 
 #include "console.h"
 #include "target.h"
+#include "tick.h"
+
+#if CONSOLE_TX_DMA
+static void console_tx_dma_setup(void);
+#endif
 
 void console_setup(uint32_t baudrate) {
     /* Setup GPIO */
@@ -38,8 +46,12 @@ void console_setup(uint32_t baudrate) {
     usart_set_flow_control(CONSOLE_USART, USART_FLOWCONTROL_NONE);
 
     usart_enable(CONSOLE_USART);
-    nvic_enable_irq(CONSOLE_USART_NVIC_LINE);
     rcc_periph_clock_enable(CONSOLE_RX_DMA_CLOCK);
+#if CONSOLE_TX_DMA
+    console_tx_dma_setup();
+#else
+    nvic_enable_irq(CONSOLE_USART_NVIC_LINE);
+#endif
 }
 
 void console_tx_buffer_clear(void);
@@ -50,6 +62,8 @@ _Static_assert(IS_POW_OF_TWO(CONSOLE_TX_BUFFER_SIZE),
                "Unmasked circular buffer size must be a power of two");
 _Static_assert(CONSOLE_TX_BUFFER_SIZE <= UINT16_MAX/2,
                "Buffer size too big for unmasked circular buffer");
+_Static_assert(IS_POW_OF_TWO(CONSOLE_RX_BUFFER_SIZE),
+               "RX byte counts must wrap cleanly around the DMA buffer");
 
 static volatile uint8_t console_tx_buffer[CONSOLE_TX_BUFFER_SIZE];
 static volatile uint8_t console_rx_buffer[CONSOLE_RX_BUFFER_SIZE];
@@ -57,16 +71,48 @@ static volatile uint8_t console_rx_buffer[CONSOLE_RX_BUFFER_SIZE];
 static volatile uint16_t console_tx_head = 0;
 static volatile uint16_t console_tx_tail = 0;
 
-static uint16_t console_rx_head = 0;
-
-void console_reconfigure(uint32_t baudrate, uint32_t databits, uint32_t stopbits,
-                         uint32_t parity) {
+/* Bytes the TX DMA is sending, starting at console_tx_head */
+static volatile uint16_t console_tx_dma_len = 0;
+
+/* TX interrupts taken and SysTick counts spent in them since
+ * console_send_load_clear(), to measure the CPU cost of transmitting */
+static volatile uint32_t console_tx_irqs = 0;
+static volatile uint32_t console_tx_irq_counts = 0;
+static uint32_t console_tx_load_start = 0;
+
+/* Bytes consumed, bytes dropped to overruns and DMA buffer wraps since the
+ * RX side was last configured. */
+static uint32_t console_rx_head = 0;
+static uint32_t console_rx_lost = 0;
+static uint32_t console_rx_overflows = 0;
+static volatile uint32_t console_rx_wraps = 0;
+
+/* Line settings requested by the USB-serial bridge */
+static uint32_t console_baudrate = DEFAULT_BAUDRATE;
+static uint32_t console_databits = 8;
+static uint32_t console_stopbits = USART_STOPBITS_1;
+static uint32_t console_parity = USART_PARITY_NONE;
+
+/* The USART belongs to the USB-serial bridge unless it is claimed for
+ * DAP UART commands or lent out for raw capture */
+enum console_owner {
+    CONSOLE_OWNER_BRIDGE,
+    CONSOLE_OWNER_CLAIMED,
+    CONSOLE_OWNER_CAPTURE,
+};
+
+static enum console_owner console_owner = CONSOLE_OWNER_BRIDGE;
+static void (*console_capture_callback)(void) = NULL;
+
+static void console_configure(uint32_t baudrate, uint32_t databits, uint32_t stopbits,
+                              uint32_t parity, uint32_t mode) {
     // Disable the UART and clear buffers
     usart_disable(CONSOLE_USART);
 
     usart_disable_rx_dma(CONSOLE_USART);
     usart_disable_tx_interrupt(CONSOLE_USART);
     nvic_disable_irq(CONSOLE_USART_NVIC_LINE);
+    nvic_disable_irq(CONSOLE_RX_DMA_NVIC_LINE);
 
     console_tx_buffer_clear();
     console_rx_buffer_clear();
@@ -80,7 +126,7 @@ void console_reconfigure(uint32_t baudrate, uint32_t databits, uint32_t stopbits
     usart_set_databits(CONSOLE_USART, databits);
     usart_set_stopbits(CONSOLE_USART, stopbits);
     usart_set_parity(CONSOLE_USART, parity);
-    usart_set_mode(CONSOLE_USART, CONSOLE_USART_MODE);
+    usart_set_mode(CONSOLE_USART, mode);
 
     dma_channel_reset(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL);
 
@@ -95,17 +141,94 @@ void console_reconfigure(uint32_t baudrate, uint32_t databits, uint32_t stopbits
     dma_set_priority(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL, DMA_CCR_PL_HIGH);
     dma_enable_circular_mode(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL);
 
+    // Count buffer wraps so that overruns can be detected, and let
+    // capture clients know about new data every half buffer
+    dma_enable_half_transfer_interrupt(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL);
+    dma_enable_transfer_complete_interrupt(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL);
+
     dma_enable_channel(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL);
 
     usart_enable_rx_dma(CONSOLE_USART);
+#if CONSOLE_TX_DMA
+    console_tx_dma_setup();
+#else
     nvic_enable_irq(CONSOLE_USART_NVIC_LINE);
+#endif
+    nvic_enable_irq(CONSOLE_RX_DMA_NVIC_LINE);
 
     // Re-enable the UART with the new settings
     usart_enable(CONSOLE_USART);
 }
 
-static bool console_tx_buffer_empty(void) {
-    return console_tx_head == console_tx_tail;
+void console_reconfigure(uint32_t baudrate, uint32_t databits, uint32_t stopbits,
+                         uint32_t parity) {
+    console_baudrate = baudrate;
+    console_databits = databits;
+    console_stopbits = stopbits;
+    console_parity = parity;
+
+    // Applied when the USART is released back to the bridge
+    if (console_owner == CONSOLE_OWNER_BRIDGE) {
+        console_configure(baudrate, databits, stopbits, parity, CONSOLE_USART_MODE);
+    }
+}
+
+uint32_t console_actual_baudrate(uint32_t baudrate) {
+    uint32_t clock = rcc_get_usart_clk_freq(CONSOLE_USART);
+
+    // The USART oversamples each bit 16 times
+    if ((baudrate == 0) || (baudrate > clock / 16)) {
+        return 0;
+    }
+
+    uint32_t divisor = (clock + baudrate / 2) / baudrate;
+    return clock / divisor;
+}
+
+bool console_bridge_attached(void) {
+    return console_owner == CONSOLE_OWNER_BRIDGE;
+}
+
+bool console_claim(uint32_t baudrate, uint32_t databits, uint32_t stopbits,
+                   uint32_t parity) {
+    if ((console_owner == CONSOLE_OWNER_CAPTURE) || (console_actual_baudrate(baudrate) == 0)) {
+        return false;
+    }
+
+    console_owner = CONSOLE_OWNER_CLAIMED;
+    console_configure(baudrate, databits, stopbits, parity, CONSOLE_USART_MODE);
+    return true;
+}
+
+bool console_capture_start(uint32_t baudrate, void (*rx_callback)(void)) {
+    if ((console_owner == CONSOLE_OWNER_CLAIMED) || (console_actual_baudrate(baudrate) == 0)) {
+        return false;
+    }
+
+    console_owner = CONSOLE_OWNER_CAPTURE;
+    console_capture_callback = rx_callback;
+    console_configure(baudrate, 8, USART_STOPBITS_1, USART_PARITY_NONE, USART_MODE_RX);
+    return true;
+}
+
+void console_release(void) {
+    if (console_owner == CONSOLE_OWNER_BRIDGE) {
+        return;
+    }
+
+    console_owner = CONSOLE_OWNER_BRIDGE;
+    console_capture_callback = NULL;
+    console_configure(console_baudrate, console_databits, console_stopbits,
+                      console_parity, CONSOLE_USART_MODE);
+}
+
+void console_recv_enable(bool enable) {
+    // The DMA position only freezes, so whatever was received stays readable
+    if (enable) {
+        usart_enable_rx_dma(CONSOLE_USART);
+    } else {
+        usart_disable_rx_dma(CONSOLE_USART);
+    }
 }
 
 static bool console_tx_buffer_full(void) {
@@ -117,41 +240,194 @@ static void console_tx_buffer_put(uint8_t data) {
     console_tx_tail++;
 }
 
+#if !CONSOLE_TX_DMA
+static bool console_tx_buffer_empty(void) {
+    return console_tx_head == console_tx_tail;
+}
+
 static uint8_t console_tx_buffer_get(void) {
     uint8_t data = console_tx_buffer[console_tx_head % CONSOLE_TX_BUFFER_SIZE];
     console_tx_head++;
     return data;
 }
+#endif
 
 void console_tx_buffer_clear(void) {
+#if CONSOLE_TX_DMA
+    dma_disable_channel(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL);
+    dma_clear_interrupt_flags(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL, DMA_TCIF);
+    console_tx_dma_len = 0;
+#endif
     console_tx_head = 0;
     console_tx_tail = 0;
 }
 
+#if CONSOLE_TX_DMA
+static void console_tx_dma_setup(void) {
+    dma_channel_reset(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL);
+    dma_set_peripheral_address(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL, (uint32_t)&USART_TDR(CONSOLE_USART));
+    dma_set_read_from_memory(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL);
+    dma_enable_memory_increment_mode(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL);
+    dma_set_peripheral_size(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL, DMA_CCR_PSIZE_8BIT);
+    dma_set_memory_size(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL, DMA_CCR_MSIZE_8BIT);
+    dma_set_priority(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL, DMA_CCR_PL_MEDIUM);
+    dma_enable_transfer_complete_interrupt(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL);
+    console_tx_dma_len = 0;
+
+    usart_enable_tx_dma(CONSOLE_USART);
+#ifdef CONSOLE_TX_DMA_NVIC_LINE
+    nvic_enable_irq(CONSOLE_TX_DMA_NVIC_LINE);
+#else
+    nvic_enable_irq(CONSOLE_RX_DMA_NVIC_LINE);
+#endif
+}
+
+/* Send the next contiguous run of the TX buffer, unless a transfer is
+ * already running. A run that wraps around the end of the buffer goes out
+ * as two transfers. Called with interrupts masked or from the DMA ISR. */
+static void console_tx_dma_start(void) {
+    uint16_t pending = (uint16_t)(console_tx_tail - console_tx_head);
+
+    // The transmitter is off while the RX pin is lent out for capture
+    if ((console_tx_dma_len != 0) || (pending == 0) ||
+        (console_owner == CONSOLE_OWNER_CAPTURE)) {
+        return;
+    }
+
+    uint16_t start = console_tx_head % CONSOLE_TX_BUFFER_SIZE;
+    uint16_t len = CONSOLE_TX_BUFFER_SIZE - start;
+    if (len > pending) {
+        len = pending;
+    }
+
+    console_tx_dma_len = len;
+    dma_set_memory_address(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL, (uint32_t)&console_tx_buffer[start]);
+    dma_set_number_of_data(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL, len);
+    dma_enable_channel(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL);
+}
+#endif
+
+void console_send_load(uint32_t* irqs, uint32_t* irq_us, uint32_t* elapsed_ms) {
+    uint32_t counts_per_us = get_timestamp_counts_per_us();
+    CM_ATOMIC_BLOCK() {
+        *irqs = console_tx_irqs;
+        *irq_us = (counts_per_us != 0) ? (console_tx_irq_counts / counts_per_us) : 0;
+    }
+    *elapsed_ms = get_ticks() - console_tx_load_start;
+}
+
+void console_send_load_clear(void) {
+    CM_ATOMIC_BLOCK() {
+        console_tx_irqs = 0;
+        console_tx_irq_counts = 0;
+        console_tx_load_start = get_ticks();
+    }
+}
+
 size_t console_send_buffer_space(void) {
     return CONSOLE_TX_BUFFER_SIZE - (uint16_t)(console_tx_tail - console_tx_head);
 }
 
-static bool console_rx_buffer_empty(void) {
-    if (DMA_CCR(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL) & DMA_CCR_EN) {
-        uint16_t console_rx_tail = (CONSOLE_RX_BUFFER_SIZE - DMA_CNDTR(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL)) % CONSOLE_RX_BUFFER_SIZE;
-        return console_rx_tail == console_rx_head;
-    } else {
-        return true;
+/* Total bytes written by the DMA since the RX side was configured */
+static uint32_t console_rx_tail(void) {
+    uint32_t wraps;
+    uint16_t remaining;
+    bool wrapped;
+
+    do {
+        wraps = console_rx_wraps;
+        remaining = DMA_CNDTR(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL);
+        wrapped = dma_get_interrupt_flag(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL, DMA_TCIF);
+    } while (wraps != console_rx_wraps);
+
+    uint16_t position = CONSOLE_RX_BUFFER_SIZE - remaining;
+    if (wrapped && (position < CONSOLE_RX_BUFFER_SIZE / 2)) {
+        // The DMA reloaded before the interrupt could count it
+        wraps++;
     }
+
+    return wraps * CONSOLE_RX_BUFFER_SIZE + position;
 }
 
-static uint8_t console_rx_buffer_get(void) {
-    uint8_t data = console_rx_buffer[console_rx_head];
-    console_rx_head = (console_rx_head + 1) % CONSOLE_RX_BUFFER_SIZE;
-    return data;
+/* Unread bytes in the RX buffer. If the DMA has lapped the reader, the
+ * oldest bytes are already overwritten, so everything unread is dropped. */
+static uint32_t console_rx_level(void) {
+    if (!(DMA_CCR(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL) & DMA_CCR_EN)) {
+        return 0;
+    }
+
+    uint32_t tail = console_rx_tail();
+    uint32_t level = tail - console_rx_head;
+    if (level > CONSOLE_RX_BUFFER_SIZE) {
+        console_rx_lost += level;
+        console_rx_overflows++;
+        console_rx_head = tail;
+        level = 0;
+    }
+    return level;
 }
 
 void console_rx_buffer_clear(void) {
     console_rx_head = 0;
+    console_rx_lost = 0;
+    console_rx_overflows = 0;
+    console_rx_wraps = 0;
     dma_disable_channel(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL);
 }
 
+const uint8_t* console_recv_peek(uint16_t* len) {
+    uint32_t level = console_rx_level();
+    uint16_t offset = console_rx_head % CONSOLE_RX_BUFFER_SIZE;
+
+    // Stop at the end of the buffer; the rest starts over at the beginning
+    if (level > (uint32_t)(CONSOLE_RX_BUFFER_SIZE - offset)) {
+        level = CONSOLE_RX_BUFFER_SIZE - offset;
+    }
+
+    *len = (uint16_t)level;
+    return (level > 0) ? (const uint8_t*)&console_rx_buffer[offset] : NULL;
+}
+
+void console_recv_skip(uint16_t len) {
+    console_rx_head += len;
+}
+
+size_t console_recv_buffer_level(void) {
+    return console_rx_level();
+}
+
+uint32_t console_recv_count(void) {
+    uint32_t level = console_rx_level();
+    return console_rx_head + level;
+}
+
+uint32_t console_recv_lost(void) {
+    // Account for an overrun that hasn't been noticed by a read yet
+    console_rx_level();
+    return console_rx_lost;
+}
+
+uint32_t console_recv_overflows(void) {
+    console_rx_level();
+    return console_rx_overflows;
+}
+
+void console_recv_flush(void) {
+    console_rx_head += console_rx_level();
+}
+
+void console_send_flush(void) {
+    // Drop whatever hasn't been handed to the USART yet
+    CM_ATOMIC_BLOCK() {
+#if CONSOLE_TX_DMA
+        dma_disable_channel(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL);
+        dma_clear_interrupt_flags(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL, DMA_TCIF);
+        console_tx_dma_len = 0;
+#endif
+        console_tx_head = console_tx_tail;
+    }
+}
+
 size_t console_send_buffered(const uint8_t* data, size_t num_bytes) {
     size_t bytes_written = 0;
 
@@ -159,39 +435,35 @@ size_t console_send_buffered(const uint8_t* data, size_t num_bytes) {
         console_tx_buffer_put(data[bytes_written++]);
     }
 
-    if (!console_tx_buffer_empty()) {
+#if CONSOLE_TX_DMA
+    CM_ATOMIC_BLOCK() {
+        console_tx_dma_start();
+    }
+#else
+    // The transmitter is off while the RX pin is lent out for capture
+    if (!console_tx_buffer_empty() && (console_owner != CONSOLE_OWNER_CAPTURE)) {
         usart_enable_tx_interrupt(CONSOLE_USART);
     }
+#endif
 
     return bytes_written;
 }
 
 size_t console_recv_buffered(uint8_t* data, size_t max_bytes) {
     size_t bytes_read = 0;
-    if (max_bytes == 1) {
-        if (!console_rx_buffer_empty()) {
-            *data = console_rx_buffer_get();
-            bytes_read = 1;
-        }
-    } else if (!console_rx_buffer_empty()) {
-        uint16_t console_rx_tail = (CONSOLE_RX_BUFFER_SIZE - DMA_CNDTR(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL)) % CONSOLE_RX_BUFFER_SIZE;
-        if (console_rx_head > console_rx_tail) {
-            while (console_rx_head < CONSOLE_RX_BUFFER_SIZE && bytes_read < max_bytes) {
-                data[bytes_read++] = console_rx_buffer[console_rx_head++];
-            }
-            if (console_rx_head == CONSOLE_RX_BUFFER_SIZE) {
-                console_rx_head = 0;
-            }
-        }
 
-        if ((bytes_read < max_bytes) && (console_rx_head < console_rx_tail)) {
-            while (console_rx_head < console_rx_tail && bytes_read < max_bytes) {
-                data[bytes_read++] = console_rx_buffer[console_rx_head++];
-            }
-            if (console_rx_head == CONSOLE_RX_BUFFER_SIZE) {
-                console_rx_head = 0;
-            }
+    while (bytes_read < max_bytes) {
+        uint16_t len = 0;
+        const uint8_t* chunk = console_recv_peek(&len);
+        if (chunk == NULL) {
+            break;
+        }
+        if (len > max_bytes - bytes_read) {
+            len = (uint16_t)(max_bytes - bytes_read);
         }
+        memcpy(&data[bytes_read], chunk, len);
+        console_recv_skip(len);
+        bytes_read += len;
     }
 
     return bytes_read;
@@ -205,13 +477,59 @@ uint8_t console_recv_blocking(void) {
     return usart_recv_blocking(CONSOLE_USART);
 }
 
+#if CONSOLE_TX_DMA
+static void console_tx_dma_isr(void) {
+    if (dma_get_interrupt_flag(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL, DMA_TCIF)) {
+        uint32_t start = get_timestamp();
+
+        dma_clear_interrupt_flags(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL, DMA_TCIF);
+        dma_disable_channel(CONSOLE_TX_DMA_CONTROLLER, CONSOLE_TX_DMA_CHANNEL);
+        console_tx_head += console_tx_dma_len;
+        console_tx_dma_len = 0;
+        console_tx_dma_start();
+
+        console_tx_irqs++;
+        console_tx_irq_counts += get_timestamp() - start;
+    }
+}
+
+#ifdef CONSOLE_TX_DMA_IRQ_NAME
+void CONSOLE_TX_DMA_IRQ_NAME(void) {
+    console_tx_dma_isr();
+}
+#endif
+#else
 void CONSOLE_USART_IRQ_NAME(void) {
     if (usart_get_flag(CONSOLE_USART, USART_FLAG_TXE)) {
+        uint32_t start = get_timestamp();
+
         if (!console_tx_buffer_empty()) {
             usart_word_t buffered_byte = console_tx_buffer_get();
             usart_send(CONSOLE_USART, buffered_byte);
         } else {
             usart_disable_tx_interrupt(CONSOLE_USART);
         }
+
+        console_tx_irqs++;
+        console_tx_irq_counts += get_timestamp() - start;
+    }
+}
+#endif
+
+void CONSOLE_RX_DMA_IRQ_NAME(void) {
+#if CONSOLE_TX_DMA && !defined(CONSOLE_TX_DMA_IRQ_NAME)
+    console_tx_dma_isr();
+#endif
+
+    if (dma_get_interrupt_flag(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL, DMA_HTIF)) {
+        dma_clear_interrupt_flags(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL, DMA_HTIF);
+    }
+    if (dma_get_interrupt_flag(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL, DMA_TCIF)) {
+        dma_clear_interrupt_flags(CONSOLE_RX_DMA_CONTROLLER, CONSOLE_RX_DMA_CHANNEL, DMA_TCIF);
+        console_rx_wraps++;
+    }
+
+    if (console_capture_callback != NULL) {
+        console_capture_callback();
     }
 }
@@ -19,6 +19,7 @@
 #ifndef CONSOLE_H_INCLUDED
 #define CONSOLE_H_INCLUDED
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <libopencm3/stm32/usart.h>
 
@@ -34,4 +35,38 @@ extern size_t console_send_buffered(const uint8_t* data, size_t num_bytes);
 extern size_t console_recv_buffered(uint8_t* data, size_t max_bytes);
 extern size_t console_send_buffer_space(void);
 
+/* CPU cost of transmitting: TX interrupts taken, microseconds spent in them
+ * and milliseconds elapsed since console_send_load_clear() */
+extern void console_send_load(uint32_t* irqs, uint32_t* irq_us, uint32_t* elapsed_ms);
+extern void console_send_load_clear(void);
+
+/* Read received bytes in place: peek returns the longest contiguous run
+ * and skip consumes bytes from it. */
+extern const uint8_t* console_recv_peek(uint16_t* len);
+extern void console_recv_skip(uint16_t len);
+extern size_t console_recv_buffer_level(void);
+extern void console_recv_flush(void);
+extern void console_send_flush(void);
+/* Bytes received, bytes dropped because the RX buffer overflowed and the
+ * number of overflows, all counted since the USART was last configured */
+extern uint32_t console_recv_count(void);
+extern uint32_t console_recv_lost(void);
+extern uint32_t console_recv_overflows(void);
+/* Stop or resume receiving without losing buffered data */
+extern void console_recv_enable(bool enable);
+
+/* Closest baudrate the USART can generate, or 0 if out of range */
+extern uint32_t console_actual_baudrate(uint32_t baudrate);
+
+/* The USB-serial bridge owns the USART unless it is claimed (e.g. for DAP
+ * UART commands) or lent out for raw 8N1 RX capture (e.g. SWO trace). The
+ * owner can reconfigure it by claiming it again; console_release() restores
+ * the bridge's line settings. While capturing, nothing is transmitted and
+ * rx_callback runs from the DMA interrupt every half buffer. */
+extern bool console_bridge_attached(void);
+extern bool console_claim(uint32_t baudrate, uint32_t databits,
+                          uint32_t stopbits, uint32_t parity);
+extern bool console_capture_start(uint32_t baudrate, void (*rx_callback)(void));
+extern void console_release(void);
+
 #endif
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2026, Devan Lai
+ *
+ * Permission to use, copy, modify, and/or distribute this software
+ * for any purpose with or without fee is hereby granted, provided
+ * that the above copyright notice and this permission notice
+ * appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+    HAL for the host build: the debug port pins are wired to the
+    simulated SW-DP in swd_sim.c instead of GPIO registers.
+*/
+
+#ifndef __DAP_HAL_H__
+#define __DAP_HAL_H__
+
+#include <stdint.h>
+#include "DAP/CMSIS_DAP_config.h"
+#include "swd_sim.h"
+
+#define __nop() __asm__ volatile ("nop")
+
+/*
+ * TIMESTAMP SUPPORT
+ */
+
+static __inline uint32_t TIMESTAMP_GET (void) {
+  return swd_sim_get_ticks();
+}
+
+/*
+ * CRC SUPPORT
+ */
+
+// Software model of the STM32 CRC unit (CRC-32/MPEG-2)
+static uint32_t crc32_value;
+
+static __inline void CRC32_RESET (void) {
+  crc32_value = 0xFFFFFFFFU;
+}
+
+static __inline void CRC32_ADD (uint32_t word) {
+  int i;
+  crc32_value ^= word;
+  for (i = 0; i < 32; i++) {
+    crc32_value = (crc32_value & 0x80000000U) ? ((crc32_value << 1) ^ 0x04C11DB7U) : (crc32_value << 1);
+  }
+}
+
+static __inline uint32_t CRC32_GET (void) {
+  return crc32_value;
+}
+
+/*
+SWD functionality
+*/
+
+static __inline void PORT_SWD_SETUP (void)
+{
+#if (DAP_SWD_GANG != 0)
+    swd_sim.swdio_out = SWD_GANG_SWDIO_PINS;
+#else
+    swd_sim.swdio_out = 1;
+#endif
+    swd_sim.swdio_oe = 1;
+    swd_sim.swclk = 1;
+}
+
+static __inline void PORT_OFF (void)
+{
+    swd_sim.swdio_oe = 0;
+}
+
+static __inline void PIN_SWCLK_TCK_SET (void)
+{
+    if (!swd_sim.swclk) {
+        swd_sim.swclk = 1;
+        swd_sim.edges++;
+        swd_sim_clock();
+    }
+}
+
+static __inline void PIN_SWCLK_TCK_CLR (void)
+{
+    if (swd_sim.swclk) {
+        swd_sim.swclk = 0;
+        swd_sim.edges++;
+    }
+}
+
+static __inline uint32_t PIN_SWDIO_IN (void)
+{
+    if (swd_sim.target_oe & 1) {
+        return swd_sim.target_out & 1;
+    }
+    // Pulled up when nobody drives the line
+    return (swd_sim.swdio_oe & 1) ? (swd_sim.swdio_out & 1) : 0x1;
+}
+
+static __inline uint32_t PIN_SWDIO_TMS_IN  (void)
+{
+    return PIN_SWDIO_IN();
+}
+
+static __inline void PIN_SWDIO_TMS_SET (void)
+{
+    swd_sim.swdio_out |= 1;
+}
+
+static __inline void PIN_SWDIO_TMS_CLR (void)
+{
+    swd_sim.swdio_out &= ~1;
+}
+
+static __inline void PIN_SWDIO_OUT (uint32_t bit)
+{
+    swd_sim.swdio_out = (swd_sim.swdio_out & ~1) | (bit & 1);
+}
+
+static __inline void     PIN_SWDIO_OUT_ENABLE  (void)
+{
+    swd_sim.swdio_oe |= 1;
+}
+
+static __inline void     PIN_SWDIO_OUT_DISABLE (void)
+{
+    swd_sim.swdio_oe &= ~1;
+}
+
+/*
+  SWD gang functionality: line N of the model goes to board N
+*/
+
+#if (DAP_SWD_GANG != 0)
+
+static __inline void PIN_SWD_GANG_OUT (uint32_t pins)
+{
+    swd_sim.swdio_out = (swd_sim.swdio_out & ~SWD_GANG_SWDIO_PINS) | pins;
+}
+
+static __inline void PIN_SWD_GANG_CLR_OUT (uint32_t pins)
+{
+    PIN_SWD_GANG_OUT(pins);
+    PIN_SWCLK_TCK_CLR();
+}
+
+static __inline uint32_t PIN_SWD_GANG_IN (void)
+{
+    uint32_t target = swd_sim.target_oe & swd_sim.target_out;
+    uint32_t host = ~swd_sim.target_oe & swd_sim.swdio_oe & swd_sim.swdio_out;
+    uint32_t pulled_up = ~swd_sim.target_oe & ~swd_sim.swdio_oe;
+
+    return (target | host | pulled_up) & SWD_GANG_SWDIO_PINS;
+}
+
+static __inline void PIN_SWD_GANG_OUT_ENABLE (uint32_t pins)
+{
+    swd_sim.swdio_oe |= pins;
+}
+
+static __inline void PIN_SWD_GANG_OUT_DISABLE (uint32_t pins)
+{
+    swd_sim.swdio_oe &= ~pins;
+}
+
+#endif
+
+/*
+  JTAG-only functionality: TCK and TMS are SWCLK and SWDIO
+*/
+
+static __inline void PORT_JTAG_SETUP (void) {
+    PORT_SWD_SETUP();
+    swd_sim.tdi = 1;
+}
+
+static __inline uint32_t PIN_TDI_IN  (void) {
+    return swd_sim.tdi;
+}
+
+static __inline void     PIN_TDI_OUT (uint32_t bit) {
+    swd_sim.tdi = bit & 1;
+}
+
+static __inline uint32_t PIN_TDO_IN (void) {
+    return swd_sim.tdo;
+}
+
+static __inline uint32_t PIN_nTRST_IN (void) {  return 0; }
+
+static __inline void     PIN_nTRST_OUT  (uint32_t bit) { (void)bit; }
+
+/*
+  other functionality
+*/
+static __inline uint32_t PIN_SWCLK_TCK_IN  (void) {
+    return swd_sim.swclk;
+}
+
+static __inline uint32_t PIN_nRESET_IN  (void) {
+    return swd_sim.nreset;
+}
+
+static __inline void PIN_nRESET_OUT (uint32_t bit) {
+    swd_sim.nreset = bit & 1;
+}
+
+static __inline void LED_CONNECTED_OUT (uint32_t bit) { (void)bit; }
+
+static __inline void LED_RUNNING_OUT (uint32_t bit) { (void)bit; }
+
+static __inline void LED_ACTIVITY_OUT (uint32_t bit) { (void)bit; }
+
+static __inline void DAP_SETUP (void) {
+    swd_sim.nreset = 1;
+}
+
+static __inline uint32_t RESET_TARGET (void) { return 0; }
+
+#endif
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2026, Devan Lai
+ *
+ * Permission to use, copy, modify, and/or distribute this software
+ * for any purpose with or without fee is hereby granted, provided
+ * that the above copyright notice and this permission notice
+ * appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef CONFIG_H_INCLUDED
+#define CONFIG_H_INCLUDED
+
+#define PRODUCT_NAME "dapsim"
+
+#define CDC_AVAILABLE 0
+#define VCDC_AVAILABLE 0
+#define RTT_AVAILABLE 1
+#define DFU_AVAILABLE 0
+
+#define BULK_AVAILABLE 1
+#define HID_AVAILABLE 0
+#define WINUSB_AVAILABLE 0
+#define SWO_STREAM_AVAILABLE 1
+#define PC_SAMPLE_AVAILABLE 1
+
+#define LED_OPEN_DRAIN 0
+
+#endif
@@ -0,0 +1,766 @@
+/*
+ * Copyright (c) 2026, Devan Lai
+ *
+ * Permission to use, copy, modify, and/or distribute this software
+ * for any purpose with or without fee is hereby granted, provided
+ * that the above copyright notice and this permission notice
+ * appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * dapsim: runs the CMSIS-DAP command engine against the simulated SWD
+ * target in swd_sim.c and reports how many SWCLK edges and host cycles
+ * each command spends per SWD transfer.
+ *
+ * A request stream is a text file with one command packet per line,
+ * written as hex bytes. Blank lines and lines starting with '#' are
+ * ignored. Without a stream file, a built-in flash-programming style
+ * workload is used.
+ *
+ * With -q, the requests are instead sent through the DAP app and the bulk
+ * interface over the simulated USB endpoints in usb_sim.c, keeping up to
+ * the given number of commands outstanding, to measure how many commands
+ * per second the probe side of the pipeline sustains. With -l, each bulk
+ * packet also takes a fixed time to cross the bus in either direction, as
+ * it does between a debugger and a real probe.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "DAP/CMSIS_DAP_hal.h"
+#include "DAP/CMSIS_DAP.h"
+#include "DAP/app.h"
+#include "USB/composite_usb_conf.h"
+#include "swd_sim.h"
+#include "usb_sim.h"
+
+/* dap42 vendor commands, as numbered in app.c */
+#define ID_DAP_VENDOR_MEM_READ  ID_DAP_Vendor2
+#define ID_DAP_VENDOR_MEM_WRITE ID_DAP_Vendor3
+#define ID_DAP_VENDOR_MEM_CRC   ID_DAP_Vendor4
+#define ID_DAP_VENDOR_FLASH_SETUP   ID_DAP_Vendor5
+#define ID_DAP_VENDOR_FLASH_PROGRAM ID_DAP_Vendor6
+#define ID_DAP_VENDOR_FLASH_FINISH  ID_DAP_Vendor7
+#define ID_DAP_VENDOR_WATCH         ID_DAP_Vendor8
+#define ID_DAP_VENDOR_WATCH_EVENT   ID_DAP_Vendor9
+#define ID_DAP_VENDOR_RTT           ID_DAP_Vendor10
+#define ID_DAP_VENDOR_PC_SAMPLE     ID_DAP_Vendor11
+#define ID_DAP_VENDOR_TARGET_SELECT ID_DAP_Vendor12
+#define ID_DAP_VENDOR_GANG_SEQUENCE ID_DAP_Vendor13
+#define ID_DAP_VENDOR_GANG_TRANSFER ID_DAP_Vendor14
+#define ID_DAP_VENDOR_WAIT_BACKOFF  ID_DAP_Vendor15
+#define ID_DAP_VENDOR_ACK_STATS     ID_DAP_Vendor16
+
+static const char builtin_stream[] =
+    "# Connect, switch to SWD and power up the debug domain\n"
+    "02 01\n"
+    "04 00 64 00 00 00\n"
+    "13 00\n"
+    "12 33 ff ff ff ff ff ff ff\n"
+    "12 10 9e e7\n"
+    "12 33 ff ff ff ff ff ff ff\n"
+    "12 08 00\n"
+    "05 00 01 02\n"
+    "05 00 01 00 1e 00 00 00\n"
+    "05 00 01 08 00 00 00 00\n"
+    "05 00 01 04 00 00 00 50\n"
+    "05 00 01 06\n"
+    "05 00 01 01 52 00 00 23\n"
+    "# Write and read back a page of SRAM\n"
+    "05 00 01 05 00 00 00 20\n"
+    "06 00 0e 00 0d 00 01 02 03 04 05 06 07 08 09 0a 0b 0c 0d 0e 0f 10 11 12 13 14 15 16 17"
+    " 18 19 1a 1b 1c 1d 1e 1f 20 21 22 23 24 25 26 27 28 29 2a 2b 2c 2d 2e 2f 30 31 32 33 34 35 36 37\n"
+    "05 00 01 05 00 00 00 20\n"
+    "06 00 0f 00 0f\n"
+    "# Poll DHCSR through TAR/DRW\n"
+    "05 00 04 05 f0 ed 00 e0 0f 0f 0f\n";
+
+struct command_stats {
+    uint32_t count;
+    uint32_t failed;
+    uint64_t transfers;
+    uint64_t edges;
+    uint64_t cycles;
+};
+
+static struct command_stats stats[256];
+
+/* Commands sent through the USB pipeline but not yet answered */
+struct pipeline_state {
+    uint32_t depth;
+    uint32_t outstanding;
+    uint32_t max_outstanding;
+    uint32_t commands;
+    uint32_t failed;
+    uint32_t out_of_step;   /* Responses that don't answer the oldest request */
+    uint32_t read_packets;  /* Packets still to come from a memory read */
+    uint32_t samples;       /* PC samples from the trace endpoint */
+    uint32_t sample_packets;
+    uint32_t sample_pcs;    /* Times the sampled PC changed */
+    uint32_t sample_first;  /* Timestamps of the first and last sample */
+    uint32_t sample_last;
+    uint16_t rx_len;
+    uint8_t response[DAP_PACKET_SIZE];
+    uint8_t sent[256];      /* Command IDs awaiting a response, oldest first */
+    uint8_t sent_head;
+    uint8_t sent_tail;
+};
+
+static struct pipeline_state pipeline;
+
+/* Bulk packets on their way across the simulated bus, delivered in order
+   once the bus latency has passed */
+#define USB_QUEUE_SIZE 64U
+
+struct usb_packet {
+    uint64_t due_us;
+    uint16_t len;
+    uint8_t data[USB_BULK_MAX_PACKET_SIZE];
+};
+
+struct usb_queue {
+    struct usb_packet packets[USB_QUEUE_SIZE];
+    uint32_t head;
+    uint32_t count;
+};
+
+static uint32_t usb_latency_us;
+static struct usb_queue usb_out;
+static struct usb_queue usb_in;
+
+static uint64_t read_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void usb_queue_push(struct usb_queue* queue, const uint8_t* data, uint16_t len) {
+    struct usb_packet* packet = &queue->packets[(queue->head + queue->count) % USB_QUEUE_SIZE];
+    packet->due_us = usb_latency_us ? (read_us() + usb_latency_us) : 0;
+    packet->len = len;
+    memcpy(packet->data, data, len);
+    queue->count++;
+}
+
+/* The oldest packet in the queue, if it has crossed the bus yet */
+static struct usb_packet* usb_queue_due(struct usb_queue* queue) {
+    struct usb_packet* packet = &queue->packets[queue->head];
+    if ((queue->count == 0) || (packet->due_us && (packet->due_us > read_us()))) {
+        return NULL;
+    }
+    return packet;
+}
+
+static void usb_queue_pop(struct usb_queue* queue) {
+    queue->head = (queue->head + 1) % USB_QUEUE_SIZE;
+    queue->count--;
+}
+
+static uint64_t read_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static const char* command_name(uint8_t id) {
+    switch (id) {
+        case ID_DAP_Info:               return "DAP_Info";
+        case ID_DAP_HostStatus:         return "DAP_HostStatus";
+        case ID_DAP_Connect:            return "DAP_Connect";
+        case ID_DAP_Disconnect:         return "DAP_Disconnect";
+        case ID_DAP_TransferConfigure:  return "DAP_TransferConfigure";
+        case ID_DAP_Transfer:           return "DAP_Transfer";
+        case ID_DAP_TransferBlock:      return "DAP_TransferBlock";
+        case ID_DAP_TransferAbort:      return "DAP_TransferAbort";
+        case ID_DAP_WriteABORT:         return "DAP_WriteABORT";
+        case ID_DAP_Delay:              return "DAP_Delay";
+        case ID_DAP_ResetTarget:        return "DAP_ResetTarget";
+        case ID_DAP_SWJ_Pins:           return "DAP_SWJ_Pins";
+        case ID_DAP_SWJ_Clock:          return "DAP_SWJ_Clock";
+        case ID_DAP_SWJ_Sequence:       return "DAP_SWJ_Sequence";
+        case ID_DAP_SWD_Configure:      return "DAP_SWD_Configure";
+        case ID_DAP_SWD_Sequence:       return "DAP_SWD_Sequence";
+        case ID_DAP_JTAG_Sequence:      return "DAP_JTAG_Sequence";
+        case ID_DAP_JTAG_Configure:     return "DAP_JTAG_Configure";
+        case ID_DAP_JTAG_IDCODE:        return "DAP_JTAG_IDCODE";
+        case ID_DAP_QueueCommands:      return "DAP_QueueCommands";
+        case ID_DAP_ExecuteCommands:    return "DAP_ExecuteCommands";
+        case ID_DAP_VENDOR_MEM_READ:    return "MEM_Read";
+        case ID_DAP_VENDOR_MEM_WRITE:   return "MEM_Write";
+        case ID_DAP_VENDOR_MEM_CRC:     return "MEM_Crc32";
+        case ID_DAP_VENDOR_FLASH_SETUP:   return "FLASH_Setup";
+        case ID_DAP_VENDOR_FLASH_PROGRAM: return "FLASH_Program";
+        case ID_DAP_VENDOR_FLASH_FINISH:  return "FLASH_Finish";
+        case ID_DAP_VENDOR_WATCH:         return "MEM_Watch";
+        case ID_DAP_VENDOR_WATCH_EVENT:   return "MEM_WatchEvent";
+        case ID_DAP_VENDOR_RTT:           return "RTT_Start";
+        case ID_DAP_VENDOR_PC_SAMPLE:     return "SAMPLE_Start";
+        case ID_DAP_VENDOR_TARGET_SELECT: return "DAP_TargetSelect";
+        case ID_DAP_VENDOR_GANG_SEQUENCE: return "GANG_Sequence";
+        case ID_DAP_VENDOR_GANG_TRANSFER: return "GANG_Transfer";
+        case ID_DAP_VENDOR_WAIT_BACKOFF:  return "DAP_WaitBackoff";
+        case ID_DAP_VENDOR_ACK_STATS:     return "DAP_AckStats";
+        default:                        return NULL;
+    }
+}
+
+/* Returns 1 if a transfer command did not complete with an OK ack */
+static int transfer_failed(const uint8_t* response) {
+    uint8_t ack;
+    switch (response[0]) {
+        case ID_DAP_Transfer:
+            ack = response[2];
+            break;
+        case ID_DAP_TransferBlock:
+            ack = response[3];
+            break;
+        case ID_DAP_VENDOR_MEM_READ:
+        case ID_DAP_VENDOR_MEM_WRITE:
+        case ID_DAP_VENDOR_MEM_CRC:
+        case ID_DAP_VENDOR_FLASH_SETUP:
+        case ID_DAP_VENDOR_FLASH_PROGRAM:
+        case ID_DAP_VENDOR_FLASH_FINISH:
+        case ID_DAP_VENDOR_WATCH:
+        case ID_DAP_VENDOR_RTT:
+        case ID_DAP_VENDOR_PC_SAMPLE:
+        case ID_DAP_VENDOR_TARGET_SELECT:
+            ack = response[1];
+            break;
+        case ID_DAP_VENDOR_GANG_TRANSFER:
+            /* Failed if any of the targets dropped out */
+            return response[3] != response[2];
+        default:
+            return 0;
+    }
+    return (ack & 0x1F) != DAP_TRANSFER_OK;
+}
+
+static void execute(const uint8_t* request, int verbose) {
+    uint8_t response[DAP_PACKET_SIZE];
+    struct command_stats* entry = &stats[request[0]];
+    uint32_t requests = swd_sim.requests;
+    uint32_t edges = swd_sim.edges;
+    uint64_t start;
+    uint32_t num;
+    uint32_t i;
+
+    memset(response, 0, sizeof(response));
+    start = read_cycles();
+    num = DAP_ExecuteCommand(request, response);
+    entry->cycles += read_cycles() - start;
+    entry->count++;
+    entry->transfers += swd_sim.requests - requests;
+    entry->edges += swd_sim.edges - edges;
+    if (transfer_failed(response)) {
+        entry->failed++;
+    }
+
+    if (verbose) {
+        printf("<");
+        for (i = 0; i < (num & 0xFFFF); i++) {
+            printf(" %02x", response[i]);
+        }
+        printf("\n");
+    }
+}
+
+/* Drain the trace endpoint, where PC samples arrive 8 bytes at a time */
+static void pipeline_read_samples(void) {
+    static uint32_t last_pc = 0;
+    uint8_t packet[USB_BULK_MAX_PACKET_SIZE];
+    int len = usb_sim_in(ENDP_BULK_IN_SWO, packet);
+    int i;
+
+    if (len > 0) {
+        pipeline.sample_packets++;
+    }
+    for (i = 0; i + 8 <= len; i += 8) {
+        uint32_t time, pc;
+        memcpy(&time, &packet[i], sizeof(time));
+        memcpy(&pc, &packet[i + 4], sizeof(pc));
+        if (pipeline.samples++ == 0) {
+            pipeline.sample_first = time;
+        }
+        pipeline.sample_last = time;
+        if (pc != last_pc) {
+            pipeline.sample_pcs++;
+            last_pc = pc;
+        }
+    }
+}
+
+/* One pass of the probe main loop plus the host moving packets across the bus
+   and reading the IN endpoints */
+static void pipeline_poll(int verbose) {
+    struct usb_packet* packet;
+    uint8_t data[USB_BULK_MAX_PACKET_SIZE];
+    int len;
+    uint32_t i;
+
+    DAP_app_update();
+    pipeline_read_samples();
+
+    while ((packet = usb_queue_due(&usb_out)) != NULL) {
+        if (!usb_sim_out(ENDP_BULK_OUT, packet->data, packet->len)) {
+            break;
+        }
+        usb_queue_pop(&usb_out);
+    }
+
+    if (usb_in.count < USB_QUEUE_SIZE) {
+        len = usb_sim_in(ENDP_BULK_IN, data);
+        if (len >= 0) {
+            usb_queue_push(&usb_in, data, (uint16_t)len);
+        }
+    }
+    packet = usb_queue_due(&usb_in);
+    if (packet == NULL) {
+        return;
+    }
+    len = packet->len;
+    memcpy(&pipeline.response[pipeline.rx_len], packet->data, packet->len);
+    usb_queue_pop(&usb_in);
+    pipeline.rx_len += (uint16_t)len;
+    if ((len == USB_BULK_MAX_PACKET_SIZE) && (pipeline.rx_len < DAP_PACKET_SIZE)) {
+        return;
+    }
+
+    // A short packet or a full DAP packet ends the response
+    if (verbose) {
+        printf("<");
+        for (i = 0; i < pipeline.rx_len; i++) {
+            printf(" %02x", pipeline.response[i]);
+        }
+        printf("\n");
+    }
+    if (pipeline.rx_len > 0) {
+        stats[pipeline.response[0]].count++;
+        // An unknown command is answered with ID_DAP_Invalid in its place
+        if ((pipeline.response[0] != pipeline.sent[pipeline.sent_head]) &&
+            (pipeline.response[0] != ID_DAP_Invalid)) {
+            pipeline.out_of_step++;
+        }
+        if (transfer_failed(pipeline.response)) {
+            stats[pipeline.response[0]].failed++;
+            pipeline.failed++;
+        }
+        pipeline.commands++;
+        pipeline.outstanding--;
+        if ((pipeline.read_packets > 0) && (pipeline.response[0] == ID_DAP_VENDOR_MEM_READ)) {
+            pipeline.read_packets--;
+            // A failed read sends no more packets
+            if (transfer_failed(pipeline.response)) {
+                pipeline.outstanding -= pipeline.read_packets;
+                pipeline.read_packets = 0;
+            }
+        }
+        if (pipeline.read_packets == 0) {
+            pipeline.sent_head++;
+        }
+    }
+    pipeline.rx_len = 0;
+}
+
+/* Number of response packets a memory read is streamed back in */
+static uint32_t read_packet_count(const uint8_t* request) {
+    uint32_t size = request[2] & 0x3;
+    uint32_t len = (uint32_t)request[7] | ((uint32_t)request[8] << 8) |
+                   ((uint32_t)request[9] << 16) | ((uint32_t)request[10] << 24);
+    uint32_t per_packet = ((DAP_PACKET_SIZE - 4) >> size) << size;
+    return (len == 0) ? 1 : (len + per_packet - 1) / per_packet;
+}
+
+static void pipeline_submit(const uint8_t* request, int len, int verbose) {
+    int offset = 0;
+
+    // Another request would cut a streamed memory read short
+    while ((pipeline.outstanding >= pipeline.depth) || (pipeline.read_packets > 0)) {
+        pipeline_poll(verbose);
+    }
+
+    do {
+        int n = len - offset;
+        if (n > USB_BULK_MAX_PACKET_SIZE) {
+            n = USB_BULK_MAX_PACKET_SIZE;
+        }
+        while (usb_out.count >= USB_QUEUE_SIZE) {
+            pipeline_poll(verbose);
+        }
+        usb_queue_push(&usb_out, &request[offset], (uint16_t)n);
+        // Like OpenOCD and pyOCD, a request that fills its last packet is not
+        // followed by a zero-length packet
+        offset += n;
+    } while (offset < len);
+
+    // Without bus latency the request is handed over before returning
+    while (usb_queue_due(&usb_out) != NULL) {
+        pipeline_poll(verbose);
+    }
+
+    pipeline.sent[pipeline.sent_tail++] = request[0];
+    if (request[0] == ID_DAP_VENDOR_MEM_READ) {
+        pipeline.read_packets = read_packet_count(request);
+        pipeline.outstanding += pipeline.read_packets;
+    } else {
+        pipeline.outstanding++;
+    }
+    if (pipeline.outstanding > pipeline.max_outstanding) {
+        pipeline.max_outstanding = pipeline.outstanding;
+    }
+}
+
+static void pipeline_drain(int verbose) {
+    while (pipeline.outstanding > 0) {
+        pipeline_poll(verbose);
+    }
+}
+
+/* Keep the probe running with nothing outstanding, for the register watch
+   and RTT to poll the target */
+static void pipeline_idle(uint32_t ms, int verbose) {
+    uint32_t start = swd_sim_get_ticks();
+    pipeline_drain(verbose);
+    while ((swd_sim_get_ticks() - start) < ms) {
+        pipeline_poll(verbose);
+    }
+}
+
+/* Parse one line of hex bytes; returns the length or -1 on error */
+static int parse_packet(const char* line, uint8_t* packet) {
+    int len = 0;
+    unsigned int byte;
+    int consumed;
+
+    while (sscanf(line, " %2x%n", &byte, &consumed) == 1) {
+        if (len == DAP_PACKET_SIZE) {
+            return -1;
+        }
+        packet[len++] = (uint8_t)byte;
+        line += consumed;
+    }
+    while (*line == ' ' || *line == '\t' || *line == '\r' || *line == '\n') {
+        line++;
+    }
+    return (*line == '\0') ? len : -1;
+}
+
+static int run_stream(const char* name, const char* text, int verbose) {
+    uint8_t packet[DAP_PACKET_SIZE];
+    char line[2048];
+    int lineno = 0;
+    int len;
+
+    while (*text) {
+        size_t n = strcspn(text, "\n");
+        if (n >= sizeof(line)) {
+            fprintf(stderr, "%s:%d: line too long\n", name, lineno + 1);
+            return -1;
+        }
+        memcpy(line, text, n);
+        line[n] = '\0';
+        text += n + (text[n] == '\n');
+        lineno++;
+
+        if (line[strspn(line, " \t\r")] == '\0' || line[0] == '#') {
+            continue;
+        }
+        memset(packet, 0, sizeof(packet));
+        len = parse_packet(line, packet);
+        if (len <= 0) {
+            fprintf(stderr, "%s:%d: bad packet\n", name, lineno);
+            return -1;
+        }
+        if (verbose) {
+            printf("> %s\n", line);
+        }
+        if (pipeline.depth) {
+            pipeline_submit(packet, len, verbose);
+        } else {
+            execute(packet, verbose);
+        }
+    }
+    return 0;
+}
+
+static char* read_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    char* text;
+    long size;
+
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    text = malloc((size_t)size + 1);
+    if (text && fread(text, 1, (size_t)size, f) != (size_t)size) {
+        free(text);
+        text = NULL;
+    }
+    if (text) {
+        text[size] = '\0';
+    }
+    fclose(f);
+    return text;
+}
+
+static void set_clock(uint32_t clock) {
+    uint8_t request[5];
+    request[0] = ID_DAP_SWJ_Clock;
+    request[1] = (uint8_t)(clock >>  0);
+    request[2] = (uint8_t)(clock >>  8);
+    request[3] = (uint8_t)(clock >> 16);
+    request[4] = (uint8_t)(clock >> 24);
+    if (pipeline.depth) {
+        pipeline_submit(request, sizeof(request), 0);
+        pipeline_drain(0);
+    } else {
+        execute(request, 0);
+    }
+}
+
+static uint64_t read_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void print_pipeline_stats(uint64_t elapsed_ns) {
+    printf("pipeline depth %u (DAP_PACKET_COUNT %u): %u commands, %u failed, %u out of step, "
+           "%u max outstanding\n",
+           pipeline.depth, (unsigned)DAP_PACKET_COUNT, pipeline.commands, pipeline.failed,
+           pipeline.out_of_step, pipeline.max_outstanding);
+    printf("usb: %u OUT packets, %u OUT NAKs, %u IN packets\n",
+           usb_sim.out_packets, usb_sim.out_naks, usb_sim.in_packets);
+    if (elapsed_ns) {
+        printf("%.0f commands/s, %.1f ns/command\n",
+               (double)pipeline.commands * 1e9 / elapsed_ns,
+               (double)elapsed_ns / pipeline.commands);
+    }
+}
+
+/* Only worth a line when the stream switched between multidrop targets */
+static void print_target_stats(void) {
+    if (swd_sim.target_selects) {
+        printf("multidrop: %u target selects, %u SELECT writes\n",
+               swd_sim.target_selects, swd_sim.select_writes);
+    }
+}
+
+static void print_stats(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    const char* unit = "cycles";
+#else
+    const char* unit = "ns";
+#endif
+    struct command_stats total;
+    int id;
+
+    memset(&total, 0, sizeof(total));
+    printf("%-24s %8s %6s %10s %10s %12s\n",
+           "command", "count", "failed", "transfers", "edges/xfer", unit);
+    for (id = 0; id < 256; id++) {
+        const struct command_stats* entry = &stats[id];
+        const char* name = command_name((uint8_t)id);
+        char label[32];
+        if (entry->count == 0) {
+            continue;
+        }
+        if (name) {
+            snprintf(label, sizeof(label), "%s", name);
+        } else {
+            snprintf(label, sizeof(label), "0x%02X", id);
+        }
+        if (entry->transfers) {
+            printf("%-24s %8u %6u %10llu %10.1f %12.1f/xfer\n", label,
+                   entry->count, entry->failed,
+                   (unsigned long long)entry->transfers,
+                   (double)entry->edges / entry->transfers,
+                   (double)entry->cycles / entry->transfers);
+        } else {
+            printf("%-24s %8u %6u %10u %10s %12.1f/cmd\n", label,
+                   entry->count, entry->failed, 0, "-",
+                   (double)entry->cycles / entry->count);
+        }
+        if (entry->transfers) {
+            total.transfers += entry->transfers;
+            total.edges += entry->edges;
+            total.cycles += entry->cycles;
+        }
+    }
+    if (total.transfers) {
+        printf("%-24s %8s %6s %10llu %10.1f %12.1f/xfer\n", "total", "", "",
+               (unsigned long long)total.transfers,
+               (double)total.edges / total.transfers,
+               (double)total.cycles / total.transfers);
+    }
+    printf("acks: %u ok, %u wait, %u fault, %u no response; %u line resets\n",
+           swd_sim.acks_ok, swd_sim.acks_wait, swd_sim.acks_fault,
+           swd_sim.no_response, swd_sim.line_resets);
+    print_target_stats();
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [-c clock] [-n repeat] [-w every[:count]] [-f every] [-g boards[:missing]] [-q depth [-l us] [-i ms] [-r text]] [-v] [stream...]\n"
+            "  -c clock   SWJ clock in Hz to select before each stream\n"
+            "  -n repeat  run each stream this many times (default 100)\n"
+            "  -w every   answer every Nth AP access with count WAITs (default 1)\n"
+            "  -f every   fail every Nth AP access with a sticky error\n"
+            "  -g boards  number of boards on the bus for gang commands, and a mask of the ones that never answer\n"
+            "  -q depth   send requests over simulated USB, up to depth at a time\n"
+            "  -l us      with -q, time each bulk packet takes to cross the bus (default 0)\n"
+            "  -i ms      with -q, keep the probe running for ms after each stream\n"
+            "  -r text    with -q, text for an RTT channel to read from the virtual CDC port\n"
+            "  -v         print requests and responses\n",
+            argv0);
+}
+
+int main(int argc, char** argv) {
+    struct swd_sim_config config;
+    uint32_t clock = 0;
+    uint32_t repeat = 100;
+    uint32_t idle_ms = 0;
+    uint32_t i;
+    uint64_t start;
+    int verbose = 0;
+    int opt;
+    char* end;
+
+    memset(&config, 0, sizeof(config));
+    while ((opt = getopt(argc, argv, "c:n:w:f:g:q:l:i:r:vh")) != -1) {
+        switch (opt) {
+            case 'c':
+                clock = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                repeat = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'w':
+                config.wait_every = (uint32_t)strtoul(optarg, &end, 0);
+                config.wait_count = (*end == ':') ? (uint32_t)strtoul(end + 1, NULL, 0) : 1;
+                break;
+            case 'f':
+                config.fault_every = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'g':
+                config.boards = (uint32_t)strtoul(optarg, &end, 0);
+                config.missing_boards = (*end == ':') ? (uint32_t)strtoul(end + 1, NULL, 0) : 0;
+                break;
+            case 'q':
+                pipeline.depth = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'l':
+                usb_latency_us = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'i':
+                idle_ms = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                vcdc_sim.rx_len = (uint32_t)strlen(optarg);
+                if (vcdc_sim.rx_len > sizeof(vcdc_sim.rx)) {
+                    vcdc_sim.rx_len = sizeof(vcdc_sim.rx);
+                }
+                memcpy(vcdc_sim.rx, optarg, vcdc_sim.rx_len);
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 2;
+        }
+    }
+
+    swd_sim_init(&config);
+    if (pipeline.depth) {
+        DAP_app_setup(NULL, NULL);
+        usb_sim_configure();
+        // The probe's main loop runs while the host enumerates it
+        DAP_app_update();
+    } else {
+        DAP_Setup();
+    }
+
+    start = read_ns();
+    if (optind == argc) {
+        for (i = 0; i < repeat; i++) {
+            if (clock) {
+                set_clock(clock);
+            }
+            if (run_stream("builtin", builtin_stream, verbose) < 0) {
+                return 1;
+            }
+        }
+    }
+    for (; optind < argc; optind++) {
+        char* text = read_file(argv[optind]);
+        if (!text) {
+            return 1;
+        }
+        for (i = 0; i < repeat; i++) {
+            if (clock) {
+                set_clock(clock);
+            }
+            if (run_stream(argv[optind], text, verbose) < 0) {
+                free(text);
+                return 1;
+            }
+            if (pipeline.depth && idle_ms) {
+                pipeline_idle(idle_ms, verbose);
+            }
+        }
+        free(text);
+    }
+
+    if (pipeline.depth) {
+        pipeline_drain(verbose);
+        print_pipeline_stats(read_ns() - start);
+        printf("acks: %u ok, %u wait, %u fault, %u no response; %u line resets\n",
+               swd_sim.acks_ok, swd_sim.acks_wait, swd_sim.acks_fault,
+               swd_sim.no_response, swd_sim.line_resets);
+        print_target_stats();
+        if (pipeline.samples) {
+            printf("pc samples: %u in %u packets over %u us, %u PC changes\n",
+                   pipeline.samples, pipeline.sample_packets,
+                   pipeline.sample_last - pipeline.sample_first, pipeline.sample_pcs);
+        }
+        if (vcdc_sim.tx_len || vcdc_sim.rx_len) {
+            printf("rtt: %u bytes up, %u of %u bytes down: \"%.*s\"\n",
+                   vcdc_sim.tx_len, vcdc_sim.rx_pos, vcdc_sim.rx_len,
+                   (int)vcdc_sim.tx_len, (const char*)vcdc_sim.tx);
+        }
+        // A response out of step with the requests means the probe split
+        // or merged requests differently from the host
+        if (pipeline.out_of_step) {
+            return 1;
+        }
+    } else {
+        print_stats();
+    }
+    return 0;
+}
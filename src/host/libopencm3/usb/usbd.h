@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2026, Devan Lai
+ *
+ * Permission to use, copy, modify, and/or distribute this software
+ * for any purpose with or without fee is hereby granted, provided
+ * that the above copyright notice and this permission notice
+ * appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Host stand-in for the parts of the libopencm3 USB device API used by the
+ * DAP app and the bulk interface. The endpoints are implemented by usb_sim.c.
+ */
+
+#ifndef LIBOPENCM3_USBD_H
+#define LIBOPENCM3_USBD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct _usbd_device usbd_device;
+
+struct usb_setup_data {
+    uint8_t bmRequestType;
+    uint8_t bRequest;
+    uint16_t wValue;
+    uint16_t wIndex;
+    uint16_t wLength;
+} __attribute__((packed));
+
+enum usbd_request_return_codes {
+    USBD_REQ_NOTSUPP        = 0,
+    USBD_REQ_HANDLED        = 1,
+    USBD_REQ_NEXT_CALLBACK  = 2,
+};
+
+typedef void (*usbd_control_complete_callback)(usbd_device *usbd_dev,
+                                               struct usb_setup_data *req);
+
+typedef enum usbd_request_return_codes (*usbd_control_callback)(
+        usbd_device *usbd_dev, struct usb_setup_data *req, uint8_t **buf,
+        uint16_t *len, usbd_control_complete_callback *complete);
+
+typedef void (*usbd_set_config_callback)(usbd_device *usbd_dev,
+                                         uint16_t wValue);
+
+typedef void (*usbd_endpoint_callback)(usbd_device *usbd_dev, uint8_t ep);
+
+#define USB_ENDPOINT_ATTR_BULK          0x02
+#define USB_ENDPOINT_ATTR_INTERRUPT     0x03
+
+extern void usbd_ep_setup(usbd_device *usbd_dev, uint8_t addr, uint8_t type,
+                          uint16_t max_size, usbd_endpoint_callback callback);
+extern uint16_t usbd_ep_write_packet(usbd_device *usbd_dev, uint8_t addr,
+                                     const void *buf, uint16_t len);
+extern uint16_t usbd_ep_read_packet(usbd_device *usbd_dev, uint8_t addr,
+                                    void *buf, uint16_t len);
+extern void usbd_ep_nak_set(usbd_device *usbd_dev, uint8_t addr, uint8_t nak);
+
+#endif
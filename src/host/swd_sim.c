@@ -0,0 +1,812 @@
+/*
+ * Copyright (c) 2026, Devan Lai
+ *
+ * Permission to use, copy, modify, and/or distribute this software
+ * for any purpose with or without fee is hereby granted, provided
+ * that the above copyright notice and this permission notice
+ * appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Bit-level model of a SWD target: a DPv2 SW-DP with one AHB MEM-AP in
+ * front of flash, SRAM and the private peripheral bus. It samples the
+ * pins on each rising SWCLK edge and drives SWDIO for the ACK and read
+ * data phases the same way a real target would, so the unmodified
+ * SW_DP.c engine can be run against it.
+ *
+ * The core is only modelled as far as the debug registers: when it's
+ * resumed, it runs the function at PC as if it were a flash algorithm's
+ * ProgramPage(address, size, buffer), and halts on the return address a
+ * few DHCSR reads later. Otherwise it runs a loop in flash, which is where
+ * DWT_PCSR or halting finds its PC, and resuming into the loop just lets
+ * it carry on.
+ *
+ * A JTAG-DP TAP shares the pins, so that the JTAG_DP.c scans can be
+ * checked for bit alignment.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "swd_sim.h"
+
+struct swd_sim_state swd_sim;
+
+#define ACK_OK      0x1
+#define ACK_WAIT    0x2
+#define ACK_FAULT   0x4
+
+#define DP_DPIDR    0x0BC12477  /* Cortex-M0+ DPv2 */
+#define DP_TARGETID 0x01002927
+#define DP_DLPIDR   0x00000001
+
+/* Multidrop bus: two DPs differing only in TARGETINSTANCE, each with its own
+   SELECT, in front of the same core */
+#define DP_TARGETS  2
+
+#define CTRL_STICKYORUN     (1U << 1)
+#define CTRL_STICKYCMP      (1U << 4)
+#define CTRL_STICKYERR      (1U << 5)
+#define CTRL_WDATAERR       (1U << 7)
+#define CTRL_CDBGPWRUPREQ   (1U << 28)
+#define CTRL_CDBGPWRUPACK   (1U << 29)
+#define CTRL_CSYSPWRUPREQ   (1U << 30)
+#define CTRL_CSYSPWRUPACK   (1U << 31)
+#define CTRL_STICKY_MASK    (CTRL_STICKYORUN | CTRL_STICKYCMP | CTRL_STICKYERR | CTRL_WDATAERR)
+
+#define AP_CSW_RESET    0x03000042
+#define AP_BASE_VALUE   0xE00FF003
+#define AP_IDR_VALUE    0x04770031
+
+#define DHCSR_ADDR      0xE000EDF0
+#define DHCSR_DBGKEY    0xA05F0000
+#define DHCSR_C_DEBUGEN (1U << 0)
+#define DHCSR_C_HALT    (1U << 1)
+#define DHCSR_S_REGRDY  (1U << 16)
+#define DHCSR_S_HALT    (1U << 17)
+
+#define DCRSR_ADDR      0xE000EDF4
+#define DCRDR_ADDR      0xE000EDF8
+#define DCRSR_REGWnR    (1U << 16)
+
+#define DWT_PCSR_ADDR   0xE000101C
+
+/* PC a running core is found at: somewhere in a small loop in flash */
+#define CORE_LOOP_PC    0x08000200
+#define CORE_LOOP_SIZE  64
+
+/* DHCSR reads before a resumed core halts again */
+#define CORE_RUN_POLLS  3
+
+enum swd_phase {
+    PHASE_REQUEST,
+    PHASE_TURNAROUND,
+    PHASE_ACK,
+    PHASE_RDATA,
+    PHASE_WDATA,
+    PHASE_TARGETSEL,
+};
+
+static struct swd_sim_config config;
+
+/* One board of a gang, each on its own SWDIO line with a shared SWCLK */
+struct sim_board {
+    enum swd_phase phase;
+    uint32_t bits;
+    uint32_t shift;
+    uint32_t ones;
+    uint32_t request;
+    uint32_t ack;
+    uint32_t data;
+    uint32_t turnaround_left;
+    uint32_t turnaround;
+    uint8_t selected;
+    uint32_t target;
+
+    uint32_t ctrl_stat;
+    uint32_t select;
+    uint32_t selects[DP_TARGETS];
+    uint32_t rdbuff;
+    uint32_t resend;
+
+    uint32_t csw;
+    uint32_t tar;
+
+    uint32_t ap_accesses;
+    uint32_t wait_left;
+    uint8_t resume;
+
+    uint32_t core_regs[32];
+    uint32_t run_left;
+    uint32_t pc_seed;
+
+    uint8_t flash_mem[128*1024];
+    uint8_t sram_mem[64*1024];
+    uint8_t ppb_mem[1024*1024];
+};
+
+static struct sim_board boards[SWD_SIM_BOARDS];
+
+/* The board being clocked */
+static struct sim_board* sim = &boards[0];
+static uint32_t sim_line;
+
+#define FLASH_BASE  0x08000000
+#define SRAM_BASE   0x20000000
+#define PPB_BASE    0xE0000000
+
+static uint8_t* mem_lookup(uint32_t addr) {
+    if (addr - FLASH_BASE < sizeof(sim->flash_mem)) {
+        return &sim->flash_mem[addr - FLASH_BASE];
+    }
+    if (addr - SRAM_BASE < sizeof(sim->sram_mem)) {
+        return &sim->sram_mem[addr - SRAM_BASE];
+    }
+    if (addr - PPB_BASE < sizeof(sim->ppb_mem)) {
+        return &sim->ppb_mem[addr - PPB_BASE];
+    }
+    return NULL;
+}
+
+int swd_sim_mem_read(uint32_t addr, uint32_t* value) {
+    uint8_t* p = mem_lookup(addr & ~0x3U);
+    if (!p) {
+        return 0;
+    }
+    memcpy(value, p, sizeof(*value));
+    return 1;
+}
+
+int swd_sim_mem_write(uint32_t addr, uint32_t value) {
+    uint8_t* p = mem_lookup(addr & ~0x3U);
+    if (!p) {
+        return 0;
+    }
+    memcpy(p, &value, sizeof(value));
+    return 1;
+}
+
+/* Move a core register to or from DCRDR */
+static void core_transfer(uint32_t dcrsr) {
+    uint32_t* reg = &sim->core_regs[dcrsr & 0x1F];
+    if (dcrsr & DCRSR_REGWnR) {
+        swd_sim_mem_read(DCRDR_ADDR, reg);
+    } else {
+        swd_sim_mem_write(DCRDR_ADDR, *reg);
+    }
+}
+
+/* Finish the call the core was resumed into: copy R1 bytes from R2 to R0,
+ * return 0 on success and halt on the return address */
+static void core_return(void) {
+    uint32_t dhcsr;
+    uint32_t word;
+    uint32_t i;
+    int ok = 1;
+
+    for (i = 0; ok && (i < sim->core_regs[1]); i += 4) {
+        ok = swd_sim_mem_read(sim->core_regs[2] + i, &word)
+          && swd_sim_mem_write(sim->core_regs[0] + i, word);
+    }
+    sim->core_regs[0] = ok ? 0 : 1;
+    sim->core_regs[15] = sim->core_regs[14] & ~1U;
+
+    swd_sim_mem_read(DHCSR_ADDR, &dhcsr);
+    swd_sim_mem_write(DHCSR_ADDR, dhcsr | DHCSR_S_HALT);
+}
+
+/* Where a free-running core has got to in its loop */
+static uint32_t core_sample_pc(void) {
+    sim->pc_seed = sim->pc_seed * 1103515245U + 12345U;
+    return CORE_LOOP_PC + 2 * ((sim->pc_seed >> 16) % (CORE_LOOP_SIZE / 2));
+}
+
+/* Debug register read, letting a running core get on with its call */
+static int mem_read_debug(uint32_t addr, uint32_t* value) {
+    uint32_t dhcsr;
+
+    if (((addr & ~0x3U) == DHCSR_ADDR) && sim->run_left && (--sim->run_left == 0)) {
+        core_return();
+    }
+    if ((addr & ~0x3U) == DWT_PCSR_ADDR) {
+        /* PCSR reads as all ones while the core is halted */
+        swd_sim_mem_read(DHCSR_ADDR, &dhcsr);
+        *value = (dhcsr & DHCSR_S_HALT) ? 0xFFFFFFFFU : core_sample_pc();
+        return 1;
+    }
+    return swd_sim_mem_read(addr, value);
+}
+
+/* Sized write with the data on the byte lanes selected by the address */
+static int mem_write_sized(uint32_t addr, uint32_t size, uint32_t value) {
+    uint8_t* p = mem_lookup(addr & ~0x3U);
+    uint32_t lane = addr & 0x3U;
+    if (!p) {
+        return 0;
+    }
+
+    if (size == 0) {
+        p[lane] = (uint8_t)(value >> (8 * lane));
+    } else if (size == 1) {
+        lane &= 0x2U;
+        p[lane]   = (uint8_t)(value >> (8 * lane));
+        p[lane+1] = (uint8_t)(value >> (8 * lane + 8));
+    } else {
+        if ((addr & ~0x3U) == DHCSR_ADDR) {
+            if ((value & 0xFFFF0000) != DHCSR_DBGKEY) {
+                return 1;
+            }
+            value = (value & 0xFFFF) | DHCSR_S_REGRDY;
+            if ((value & (DHCSR_C_DEBUGEN | DHCSR_C_HALT)) == (DHCSR_C_DEBUGEN | DHCSR_C_HALT)) {
+                if (!(p[2] & (DHCSR_S_HALT >> 16)) && !sim->run_left) {
+                    /* Halted in the middle of its loop */
+                    sim->core_regs[15] = core_sample_pc();
+                }
+                value |= DHCSR_S_HALT;
+                sim->run_left = 0;
+            } else if ((value & DHCSR_C_DEBUGEN) && (p[2] & (DHCSR_S_HALT >> 16)) &&
+                       (sim->core_regs[15] - CORE_LOOP_PC >= CORE_LOOP_SIZE)) {
+                /* Resumed from halt into a call */
+                sim->run_left = CORE_RUN_POLLS;
+            }
+        }
+        memcpy(p, &value, sizeof(value));
+        if ((addr & ~0x3U) == DCRSR_ADDR) {
+            core_transfer(value);
+        }
+    }
+    return 1;
+}
+
+static void tar_increment(void) {
+    if (((sim->csw >> 4) & 0x3) != 0) {
+        /* Auto-increment only carries within a 1KB block */
+        uint32_t inc = 1U << (sim->csw & 0x3);
+        sim->tar = (sim->tar & ~0x3FFU) | ((sim->tar + inc) & 0x3FFU);
+    }
+}
+
+static uint32_t ap_read(uint32_t addr) {
+    uint32_t value = 0;
+    if ((sim->select >> 24) != 0) {
+        return 0;
+    }
+
+    switch (addr) {
+        case 0x00:
+            value = sim->csw;
+            break;
+        case 0x04:
+            value = sim->tar;
+            break;
+        case 0x0C:
+            if (!mem_read_debug(sim->tar, &value)) {
+                sim->ctrl_stat |= CTRL_STICKYERR;
+            }
+            tar_increment();
+            break;
+        case 0x10:
+        case 0x14:
+        case 0x18:
+        case 0x1C:
+            if (!mem_read_debug((sim->tar & ~0xFU) | (addr & 0xC), &value)) {
+                sim->ctrl_stat |= CTRL_STICKYERR;
+            }
+            break;
+        case 0xF8:
+            value = AP_BASE_VALUE;
+            break;
+        case 0xFC:
+            value = AP_IDR_VALUE;
+            break;
+        default:
+            break;
+    }
+    return value;
+}
+
+static void ap_write(uint32_t addr, uint32_t value) {
+    if ((sim->select >> 24) != 0) {
+        return;
+    }
+
+    switch (addr) {
+        case 0x00:
+            sim->csw = (value & 0xFF00FF77) | 0x40;
+            break;
+        case 0x04:
+            sim->tar = value;
+            break;
+        case 0x0C:
+            if (!mem_write_sized(sim->tar, sim->csw & 0x3, value)) {
+                sim->ctrl_stat |= CTRL_STICKYERR;
+            }
+            tar_increment();
+            break;
+        case 0x10:
+        case 0x14:
+        case 0x18:
+        case 0x1C:
+            if (!mem_write_sized((sim->tar & ~0xFU) | (addr & 0xC), 2, value)) {
+                sim->ctrl_stat |= CTRL_STICKYERR;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static uint32_t dp_read(uint32_t addr) {
+    uint32_t value = 0;
+    switch (addr) {
+        case 0x0:
+            value = DP_DPIDR;
+            break;
+        case 0x4:
+            switch (sim->select & 0xF) {
+                case 0:
+                    value = sim->ctrl_stat;
+                    if (value & CTRL_CDBGPWRUPREQ) {
+                        value |= CTRL_CDBGPWRUPACK;
+                    }
+                    if (value & CTRL_CSYSPWRUPREQ) {
+                        value |= CTRL_CSYSPWRUPACK;
+                    }
+                    break;
+                case 1:
+                    value = (sim->turnaround - 1) << 8;
+                    break;
+                case 2:
+                    value = DP_TARGETID;
+                    break;
+                case 3:
+                    value = DP_DLPIDR | (sim->target << 28);
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case 0x8:
+            value = sim->resend;
+            break;
+        case 0xC:
+            value = sim->rdbuff;
+            break;
+    }
+    return value;
+}
+
+static void dp_write(uint32_t addr, uint32_t value) {
+    switch (addr) {
+        case 0x0:
+            /* ABORT */
+            if (value & (1U << 1)) {
+                sim->ctrl_stat &= ~CTRL_STICKYCMP;
+            }
+            if (value & (1U << 2)) {
+                sim->ctrl_stat &= ~CTRL_STICKYERR;
+            }
+            if (value & (1U << 3)) {
+                sim->ctrl_stat &= ~CTRL_WDATAERR;
+            }
+            if (value & (1U << 4)) {
+                sim->ctrl_stat &= ~CTRL_STICKYORUN;
+            }
+            if (value & (1U << 0)) {
+                sim->wait_left = 0;
+            }
+            break;
+        case 0x4:
+            if ((sim->select & 0xF) == 0) {
+                sim->ctrl_stat = (sim->ctrl_stat & CTRL_STICKY_MASK)
+                              | (value & ~(CTRL_STICKY_MASK | CTRL_CDBGPWRUPACK | CTRL_CSYSPWRUPACK));
+            } else if ((sim->select & 0xF) == 1) {
+                sim->turnaround = ((value >> 8) & 0x3) + 1;
+            }
+            break;
+        case 0x8:
+            sim->select = value;
+            swd_sim.select_writes++;
+            break;
+    }
+}
+
+/* Every DP on the bus samples a TARGETSEL write; the one it matches answers */
+static void target_select(uint32_t targetsel) {
+    uint32_t target = targetsel >> 28;
+
+    sim->selected = 0;
+    if (((targetsel & 0x0FFFFFFF) == DP_TARGETID) && (target < DP_TARGETS)) {
+        sim->selects[sim->target] = sim->select;
+        sim->target = target;
+        sim->select = sim->selects[target];
+        sim->selected = 1;
+        swd_sim.target_selects++;
+    }
+}
+
+/* Decide how the target answers an AP access */
+static uint32_t ap_ack(void) {
+    if (sim->ctrl_stat & CTRL_STICKYERR) {
+        return ACK_FAULT;
+    }
+    if (sim->wait_left) {
+        sim->wait_left--;
+        return ACK_WAIT;
+    }
+    if (sim->resume) {
+        sim->resume = 0;
+        return ACK_OK;
+    }
+
+    sim->ap_accesses++;
+    if (config.wait_every && config.wait_count
+        && (sim->ap_accesses % config.wait_every) == 0) {
+        sim->wait_left = config.wait_count - 1;
+        sim->resume = 1;
+        return ACK_WAIT;
+    }
+    if (config.fault_every && (sim->ap_accesses % config.fault_every) == 0) {
+        sim->ctrl_stat |= CTRL_STICKYERR;
+        return ACK_FAULT;
+    }
+    return ACK_OK;
+}
+
+static uint32_t transfer_read(void) {
+    uint32_t addr = (sim->request & 0xC);
+    uint32_t value;
+    if (sim->request & 0x1) {
+        /* AP reads are posted: return the previous result */
+        value = sim->rdbuff;
+        sim->rdbuff = ap_read((sim->select & 0xF0) | addr);
+    } else {
+        value = dp_read(addr);
+    }
+    sim->resend = value;
+    return value;
+}
+
+static void transfer_write(uint32_t value) {
+    uint32_t addr = (sim->request & 0xC);
+    if (sim->request & 0x1) {
+        ap_write((sim->select & 0xF0) | addr, value);
+    } else {
+        dp_write(addr, value);
+    }
+}
+
+static void parse_request(uint32_t header) {
+    uint32_t request = (header >> 1) & 0xF;
+    uint32_t parity = __builtin_parity(request);
+
+    if (!(header & 0x01) || (header & 0x40) || !(header & 0x80)
+        || (((header >> 5) & 1) != parity)) {
+        /* Line resets shift in runs of ones; don't count those */
+        if (header != 0xFF) {
+            swd_sim.no_response++;
+        }
+        return;
+    }
+
+    swd_sim.requests++;
+    sim->request = request;
+
+    if (request == 0xC) {
+        /* TARGETSEL write: no response, every target samples the data */
+        sim->phase = PHASE_TARGETSEL;
+        sim->shift = 0;
+        return;
+    }
+
+    if (!sim->selected) {
+        swd_sim.no_response++;
+        return;
+    }
+
+    sim->ack = (request & 0x1) ? ap_ack() : ACK_OK;
+    if (sim->ack == ACK_OK) {
+        swd_sim.acks_ok++;
+    } else if (sim->ack == ACK_WAIT) {
+        swd_sim.acks_wait++;
+    } else {
+        swd_sim.acks_fault++;
+    }
+
+    sim->phase = PHASE_TURNAROUND;
+    sim->turnaround_left = sim->turnaround;
+}
+
+static void drive(uint32_t bit) {
+    swd_sim.target_oe |= sim_line;
+    if (bit & 1) {
+        swd_sim.target_out |= sim_line;
+    } else {
+        swd_sim.target_out &= ~sim_line;
+    }
+}
+
+static void release(void) {
+    swd_sim.target_oe &= ~sim_line;
+}
+
+static void board_clock(uint32_t bit, uint32_t host_drives) {
+    uint32_t i;
+
+    if (host_drives) {
+        if (bit) {
+            if (++sim->ones == 50) {
+                swd_sim.line_resets++;
+                release();
+                sim->phase = PHASE_REQUEST;
+                sim->bits = 0;
+                sim->selected = 1;
+                /* A line reset clears DPBANKSEL in every DP */
+                for (i = 0; i < DP_TARGETS; i++) {
+                    sim->selects[i] &= ~0xFU;
+                }
+                sim->select &= ~0xFU;
+            }
+        } else {
+            sim->ones = 0;
+        }
+
+        /* The host took the line back early; drop the transfer */
+        if ((sim->phase == PHASE_TURNAROUND) || (sim->phase == PHASE_ACK)
+            || (sim->phase == PHASE_RDATA)) {
+            release();
+            sim->phase = PHASE_REQUEST;
+            sim->bits = 0;
+        }
+    }
+
+    switch (sim->phase) {
+        case PHASE_REQUEST:
+            if (!host_drives || (sim->bits == 0 && !bit)) {
+                break;
+            }
+            if (sim->bits == 0) {
+                sim->shift = 0;
+            }
+            sim->shift |= bit << sim->bits;
+            if (++sim->bits == 8) {
+                sim->bits = 0;
+                parse_request(sim->shift);
+            }
+            break;
+        case PHASE_TURNAROUND:
+            if (--sim->turnaround_left == 0) {
+                sim->phase = PHASE_ACK;
+                sim->bits = 0;
+                drive(sim->ack);
+            }
+            break;
+        case PHASE_ACK:
+            if (++sim->bits < 3) {
+                drive(sim->ack >> sim->bits);
+            } else if (sim->ack != ACK_OK) {
+                release();
+                sim->phase = PHASE_REQUEST;
+                sim->bits = 0;
+            } else if (sim->request & 0x2) {
+                sim->data = transfer_read();
+                sim->phase = PHASE_RDATA;
+                sim->bits = 0;
+                drive(sim->data);
+            } else {
+                release();
+                sim->phase = PHASE_WDATA;
+                sim->bits = 0;
+                sim->shift = 0;
+            }
+            break;
+        case PHASE_RDATA:
+            sim->bits++;
+            if (sim->bits < 32) {
+                drive(sim->data >> sim->bits);
+            } else if (sim->bits == 32) {
+                drive(__builtin_parity(sim->data));
+            } else {
+                release();
+                sim->phase = PHASE_REQUEST;
+                sim->bits = 0;
+            }
+            break;
+        case PHASE_WDATA:
+        case PHASE_TARGETSEL:
+            if (!host_drives) {
+                break;
+            }
+            if (sim->bits < 32) {
+                sim->shift |= bit << sim->bits;
+                sim->bits++;
+                break;
+            }
+            if ((uint32_t)__builtin_parity(sim->shift) != bit) {
+                if (sim->phase == PHASE_WDATA) {
+                    sim->ctrl_stat |= CTRL_WDATAERR;
+                } else {
+                    sim->selected = 0;
+                }
+            } else if (sim->phase == PHASE_WDATA) {
+                transfer_write(sim->shift);
+            } else {
+                target_select(sim->shift);
+            }
+            sim->phase = PHASE_REQUEST;
+            sim->bits = 0;
+            break;
+    }
+}
+
+/* JTAG: a single JTAG-DP TAP, clocked alongside the SW-DP with TMS on
+   SWDIO. DPACC and APACC accesses always answer OK/FAULT and read back the
+   last value written through either of them. TDO is updated here rather
+   than on the falling edge, which reads the same to a probe that samples
+   it while TCK is low. */
+enum tap_state {
+    TAP_RESET, TAP_IDLE,
+    TAP_SELECT_DR, TAP_CAPTURE_DR, TAP_SHIFT_DR, TAP_EXIT1_DR,
+    TAP_PAUSE_DR, TAP_EXIT2_DR, TAP_UPDATE_DR,
+    TAP_SELECT_IR, TAP_CAPTURE_IR, TAP_SHIFT_IR, TAP_EXIT1_IR,
+    TAP_PAUSE_IR, TAP_EXIT2_IR, TAP_UPDATE_IR,
+};
+
+/* Next state for TMS low and high */
+static const uint8_t tap_next[16][2] = {
+    [TAP_RESET]      = { TAP_IDLE,       TAP_RESET },
+    [TAP_IDLE]       = { TAP_IDLE,       TAP_SELECT_DR },
+    [TAP_SELECT_DR]  = { TAP_CAPTURE_DR, TAP_SELECT_IR },
+    [TAP_CAPTURE_DR] = { TAP_SHIFT_DR,   TAP_EXIT1_DR },
+    [TAP_SHIFT_DR]   = { TAP_SHIFT_DR,   TAP_EXIT1_DR },
+    [TAP_EXIT1_DR]   = { TAP_PAUSE_DR,   TAP_UPDATE_DR },
+    [TAP_PAUSE_DR]   = { TAP_PAUSE_DR,   TAP_EXIT2_DR },
+    [TAP_EXIT2_DR]   = { TAP_SHIFT_DR,   TAP_UPDATE_DR },
+    [TAP_UPDATE_DR]  = { TAP_IDLE,       TAP_SELECT_DR },
+    [TAP_SELECT_IR]  = { TAP_CAPTURE_IR, TAP_RESET },
+    [TAP_CAPTURE_IR] = { TAP_SHIFT_IR,   TAP_EXIT1_IR },
+    [TAP_SHIFT_IR]   = { TAP_SHIFT_IR,   TAP_EXIT1_IR },
+    [TAP_EXIT1_IR]   = { TAP_PAUSE_IR,   TAP_UPDATE_IR },
+    [TAP_PAUSE_IR]   = { TAP_PAUSE_IR,   TAP_EXIT2_IR },
+    [TAP_EXIT2_IR]   = { TAP_SHIFT_IR,   TAP_UPDATE_IR },
+    [TAP_UPDATE_IR]  = { TAP_IDLE,       TAP_SELECT_DR },
+};
+
+#define JTAG_IR_ABORT   0x8
+#define JTAG_IR_DPACC   0xA
+#define JTAG_IR_APACC   0xB
+#define JTAG_IR_IDCODE  0xE
+#define JTAG_IR_BYPASS  0xF
+
+#define JTAG_IDCODE     0x4BA00477  /* Cortex-M3 JTAG-DP */
+#define JTAG_ACK_OK     0x2
+
+static struct {
+    uint8_t state;
+    uint8_t ir;         /* Instruction in effect */
+    uint8_t ir_shift;
+    uint8_t dr_length;
+    uint64_t dr;
+    uint32_t data;      /* Last value written by DPACC or APACC */
+} tap;
+
+static void tap_capture_dr(void) {
+    switch (tap.ir) {
+        case JTAG_IR_ABORT:
+        case JTAG_IR_DPACC:
+        case JTAG_IR_APACC:
+            tap.dr = ((uint64_t)tap.data << 3) | JTAG_ACK_OK;
+            tap.dr_length = 35;
+            break;
+        case JTAG_IR_IDCODE:
+            tap.dr = JTAG_IDCODE;
+            tap.dr_length = 32;
+            break;
+        default:
+            tap.dr = 0;
+            tap.dr_length = 1;
+            break;
+    }
+}
+
+static void tap_update_dr(void) {
+    /* RnW in bit 0, A[3:2] in bits 2:1 and the data above them */
+    if (((tap.ir == JTAG_IR_DPACC) || (tap.ir == JTAG_IR_APACC)) && !(tap.dr & 1)) {
+        tap.data = (uint32_t)(tap.dr >> 3);
+    }
+}
+
+static void tap_clock(uint32_t tms, uint32_t tdi) {
+    switch (tap.state) {
+        case TAP_RESET:
+            tap.ir = JTAG_IR_IDCODE;
+            break;
+        case TAP_CAPTURE_DR:
+            tap_capture_dr();
+            break;
+        case TAP_SHIFT_DR:
+            tap.dr = (tap.dr >> 1) | ((uint64_t)(tdi & 1) << (tap.dr_length - 1));
+            break;
+        case TAP_UPDATE_DR:
+            tap_update_dr();
+            break;
+        case TAP_CAPTURE_IR:
+            tap.ir_shift = 0x1;
+            break;
+        case TAP_SHIFT_IR:
+            tap.ir_shift = (uint8_t)((tap.ir_shift >> 1) | ((tdi & 1) << 3));
+            break;
+        case TAP_UPDATE_IR:
+            tap.ir = tap.ir_shift;
+            break;
+        default:
+            break;
+    }
+    tap.state = tap_next[tap.state][tms & 1];
+
+    /* Not shifting: TDO is released and pulled up */
+    if (tap.state == TAP_SHIFT_DR) {
+        swd_sim.tdo = tap.dr & 1;
+    } else if (tap.state == TAP_SHIFT_IR) {
+        swd_sim.tdo = tap.ir_shift & 1;
+    } else {
+        swd_sim.tdo = 1;
+    }
+}
+
+void swd_sim_clock(void) {
+    uint32_t i;
+
+    tap_clock(swd_sim.swdio_out, swd_sim.tdi);
+
+    for (i = 0; i < swd_sim.boards; i++) {
+        sim_line = 1U << i;
+        /* A board that isn't there never answers */
+        if (!(config.missing_boards & sim_line)) {
+            sim = &boards[i];
+            board_clock((swd_sim.swdio_out >> i) & 1, (swd_sim.swdio_oe >> i) & 1);
+        }
+    }
+    sim = &boards[0];
+}
+
+uint32_t swd_sim_get_ticks(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+void swd_sim_init(const struct swd_sim_config* sim_config) {
+    uint32_t i;
+
+    memset(boards, 0, sizeof(boards));
+    memset(&config, 0, sizeof(config));
+    memset(&swd_sim, 0, sizeof(swd_sim));
+    if (sim_config) {
+        config = *sim_config;
+    }
+    for (i = 0; i < SWD_SIM_BOARDS; i++) {
+        boards[i].phase = PHASE_REQUEST;
+        boards[i].turnaround = 1;
+        boards[i].selected = 1;
+        boards[i].csw = AP_CSW_RESET;
+    }
+    swd_sim.boards = config.boards ? config.boards : 1;
+    if (swd_sim.boards > SWD_SIM_BOARDS) {
+        swd_sim.boards = SWD_SIM_BOARDS;
+    }
+    swd_sim.nreset = 1;
+    memset(&tap, 0, sizeof(tap));
+    tap.ir = JTAG_IR_IDCODE;
+    swd_sim.tdo = 1;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2026, Devan Lai
+ *
+ * Permission to use, copy, modify, and/or distribute this software
+ * for any purpose with or without fee is hereby granted, provided
+ * that the above copyright notice and this permission notice
+ * appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SWD_SIM_H_INCLUDED
+#define SWD_SIM_H_INCLUDED
+
+#include <stdint.h>
+
+/* Boards that can be driven as a gang, one SWDIO line each */
+#define SWD_SIM_BOARDS 4
+
+/* Pin state and counters shared with the host HAL. SWDIO is a bit mask
+   with bit N for board N's line; bit 0 is the probe's own SWDIO pin. */
+struct swd_sim_state {
+    uint8_t swclk;
+    uint8_t swdio_out;
+    uint8_t swdio_oe;
+    uint8_t target_out;
+    uint8_t target_oe;
+    uint8_t nreset;
+    uint8_t tdi;
+    uint8_t tdo;
+    uint32_t boards;
+
+    uint32_t edges;
+    uint32_t requests;
+    uint32_t acks_ok;
+    uint32_t acks_wait;
+    uint32_t acks_fault;
+    uint32_t no_response;
+    uint32_t line_resets;
+    uint32_t target_selects;    /* TARGETSEL writes that selected a target */
+    uint32_t select_writes;     /* SELECT writes that reached a target */
+};
+
+extern struct swd_sim_state swd_sim;
+
+/* Bus setup and fault injection; WAITs and faults apply to AP accesses only */
+struct swd_sim_config {
+    uint32_t wait_every;    /* Answer every Nth AP access with WAIT (0 = never) */
+    uint32_t wait_count;    /* Number of WAITs before the access goes through */
+    uint32_t fault_every;   /* Fail every Nth AP access with a sticky error */
+    uint32_t boards;        /* Number of boards on the bus (0 = 1) */
+    uint32_t missing_boards;/* Boards that never answer, as a mask */
+};
+
+extern void swd_sim_init(const struct swd_sim_config* config);
+
+/* Called by the HAL on every rising SWCLK edge */
+extern void swd_sim_clock(void);
+
+extern uint32_t swd_sim_get_ticks(void);
+
+/* Direct access to the simulated target memory */
+extern int swd_sim_mem_read(uint32_t addr, uint32_t* value);
+extern int swd_sim_mem_write(uint32_t addr, uint32_t value);
+
+#endif
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2026, Devan Lai
+ *
+ * Permission to use, copy, modify, and/or distribute this software
+ * for any purpose with or without fee is hereby granted, provided
+ * that the above copyright notice and this permission notice
+ * appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Packet-level model of the STM32 USB device peripheral, as driven by the
+ * libopencm3 st_usbfs driver: single-buffered endpoints that NAK the host
+ * while a received packet is waiting to be read or a written packet is
+ * waiting to be sent. Endpoint callbacks run synchronously, in place of the
+ * USB interrupt, from usb_sim_out() and usb_sim_in().
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include <libopencm3/usb/usbd.h>
+
+#include "USB/composite_usb_conf.h"
+#include "USB/vcdc.h"
+#include "tick.h"
+#include "usb_sim.h"
+
+struct usb_sim_state usb_sim;
+struct vcdc_sim_state vcdc_sim;
+
+struct endpoint {
+    usbd_endpoint_callback callback;
+    bool valid;
+    bool force_nak;
+    uint16_t len;
+    uint8_t buffer[64];
+};
+
+static struct endpoint out_endpoints[8];
+static struct endpoint in_endpoints[8];
+
+static usbd_set_config_callback set_config_callbacks[USB_MAX_SET_CONFIG_CALLBACKS];
+static GenericCallback reset_callbacks[USB_MAX_RESET_CALLBACKS];
+
+static struct endpoint* get_endpoint(uint8_t addr) {
+    if (addr & 0x80) {
+        return &in_endpoints[addr & 0x7];
+    }
+    return &out_endpoints[addr & 0x7];
+}
+
+void usbd_ep_setup(usbd_device *usbd_dev, uint8_t addr, uint8_t type,
+                   uint16_t max_size, usbd_endpoint_callback callback) {
+    struct endpoint* endpoint = get_endpoint(addr);
+
+    (void)usbd_dev;
+    (void)type;
+    (void)max_size;
+
+    memset(endpoint, 0, sizeof(*endpoint));
+    endpoint->callback = callback;
+    // OUT endpoints are ready to receive, IN endpoints have nothing to send
+    endpoint->valid = !(addr & 0x80);
+}
+
+uint16_t usbd_ep_write_packet(usbd_device *usbd_dev, uint8_t addr,
+                              const void *buf, uint16_t len) {
+    struct endpoint* endpoint = get_endpoint(addr);
+
+    (void)usbd_dev;
+
+    if (endpoint->valid) {
+        return 0;
+    }
+    if (len > sizeof(endpoint->buffer)) {
+        len = sizeof(endpoint->buffer);
+    }
+    memcpy(endpoint->buffer, buf, len);
+    endpoint->len = len;
+    endpoint->valid = true;
+    return len;
+}
+
+uint16_t usbd_ep_read_packet(usbd_device *usbd_dev, uint8_t addr,
+                             void *buf, uint16_t len) {
+    struct endpoint* endpoint = get_endpoint(addr);
+
+    (void)usbd_dev;
+
+    if (len > endpoint->len) {
+        len = endpoint->len;
+    }
+    if (len > 0) {
+        memcpy(buf, endpoint->buffer, len);
+    }
+    if (!endpoint->force_nak) {
+        endpoint->valid = true;
+    }
+    return len;
+}
+
+void usbd_ep_nak_set(usbd_device *usbd_dev, uint8_t addr, uint8_t nak) {
+    struct endpoint* endpoint = get_endpoint(addr);
+
+    (void)usbd_dev;
+
+    if (addr & 0x80) {
+        return;
+    }
+    endpoint->force_nak = (nak != 0);
+    endpoint->valid = !endpoint->force_nak;
+}
+
+void cmp_usb_register_control_class_callback(uint16_t interface,
+                                             usbd_control_callback callback) {
+    (void)interface;
+    (void)callback;
+}
+
+void cmp_usb_register_set_config_callback(usbd_set_config_callback callback) {
+    int i;
+    for (i = 0; i < USB_MAX_SET_CONFIG_CALLBACKS; i++) {
+        if (set_config_callbacks[i] == NULL) {
+            set_config_callbacks[i] = callback;
+            break;
+        }
+    }
+}
+
+void cmp_usb_register_reset_callback(GenericCallback callback) {
+    int i;
+    for (i = 0; i < USB_MAX_RESET_CALLBACKS; i++) {
+        if (reset_callbacks[i] == NULL) {
+            reset_callbacks[i] = callback;
+            break;
+        }
+    }
+}
+
+void cmp_usb_register_sof_callback(GenericCallback callback) {
+    (void)callback;
+}
+
+static bool configured = false;
+
+bool cmp_usb_configured(void) {
+    return configured;
+}
+
+void usb_sim_configure(void) {
+    int i;
+    configured = true;
+    for (i = 0; i < USB_MAX_RESET_CALLBACKS; i++) {
+        if (reset_callbacks[i] != NULL) {
+            reset_callbacks[i]();
+        }
+    }
+    for (i = 0; i < USB_MAX_SET_CONFIG_CALLBACKS; i++) {
+        if (set_config_callbacks[i] != NULL) {
+            set_config_callbacks[i](NULL, 1);
+        }
+    }
+}
+
+bool usb_sim_out(uint8_t ep, const uint8_t* data, uint16_t len) {
+    struct endpoint* endpoint = get_endpoint(ep);
+
+    if (!endpoint->valid) {
+        usb_sim.out_naks++;
+        return false;
+    }
+
+    memcpy(endpoint->buffer, data, len);
+    endpoint->len = len;
+    endpoint->valid = false;
+    usb_sim.out_packets++;
+    if (endpoint->callback) {
+        endpoint->callback(NULL, ep);
+    }
+    return true;
+}
+
+int usb_sim_in(uint8_t ep, uint8_t* data) {
+    struct endpoint* endpoint = get_endpoint(ep);
+    uint16_t len;
+
+    if (!endpoint->valid) {
+        usb_sim.in_naks++;
+        return -1;
+    }
+
+    len = endpoint->len;
+    memcpy(data, endpoint->buffer, len);
+    endpoint->valid = false;
+    usb_sim.in_packets++;
+    if (endpoint->callback) {
+        endpoint->callback(NULL, ep);
+    }
+    return len;
+}
+
+/* Stand-ins for tick.c, which the DAP app uses to time requests */
+uint32_t get_timestamp(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+uint32_t get_timestamp_counts_per_us(void) {
+    return 1000;
+}
+
+/* Stand-ins for vcdc.c, which RTT.c bridges a channel to */
+size_t vcdc_send_buffer_space(void) {
+    return sizeof(vcdc_sim.tx) - vcdc_sim.tx_len;
+}
+
+size_t vcdc_send_buffered(const uint8_t* data, size_t num_bytes) {
+    if (num_bytes > vcdc_send_buffer_space()) {
+        num_bytes = vcdc_send_buffer_space();
+    }
+    memcpy(&vcdc_sim.tx[vcdc_sim.tx_len], data, num_bytes);
+    vcdc_sim.tx_len += num_bytes;
+    return num_bytes;
+}
+
+size_t vcdc_recv_buffered(uint8_t* data, size_t max_bytes) {
+    size_t n = vcdc_sim.rx_len - vcdc_sim.rx_pos;
+    if (n > max_bytes) {
+        n = max_bytes;
+    }
+    memcpy(data, &vcdc_sim.rx[vcdc_sim.rx_pos], n);
+    vcdc_sim.rx_pos += n;
+    return n;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2026, Devan Lai
+ *
+ * Permission to use, copy, modify, and/or distribute this software
+ * for any purpose with or without fee is hereby granted, provided
+ * that the above copyright notice and this permission notice
+ * appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef USB_SIM_H_INCLUDED
+#define USB_SIM_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Counters for the host side of the simulated bus */
+struct usb_sim_state {
+    uint32_t out_packets;
+    uint32_t out_naks;
+    uint32_t in_packets;
+    uint32_t in_naks;
+};
+
+extern struct usb_sim_state usb_sim;
+
+/* Run the set-config callbacks, as on enumeration */
+extern void usb_sim_configure(void);
+
+/* Send a packet to an OUT endpoint; returns false if the endpoint NAKed */
+extern bool usb_sim_out(uint8_t ep, const uint8_t* data, uint16_t len);
+
+/* Poll an IN endpoint; returns the packet length, or -1 if it NAKed */
+extern int usb_sim_in(uint8_t ep, uint8_t* data);
+
+/* Stand-in for the virtual CDC port: what the probe sent on it, and what
+   the host has written to it for the probe to read */
+struct vcdc_sim_state {
+    uint8_t  tx[4096];
+    uint32_t tx_len;
+    uint8_t  rx[256];
+    uint32_t rx_len;
+    uint32_t rx_pos;
+};
+
+extern struct vcdc_sim_state vcdc_sim;
+
+#endif
@@ -63,6 +63,39 @@ else
 	DEFS       += -DSEMIHOSTING=0
 endif
 
+####################################################################
+# Execute DAP commands from the PendSV interrupt instead of the main loop
+DAP_PENDSV     ?= 0
+
+ifeq ($(DAP_PENDSV),1)
+	DEFS       += -DDAP_PENDSV=1
+else
+	DEFS       += -DDAP_PENDSV=0
+endif
+
+####################################################################
+# Transmit console UART data by DMA instead of one interrupt per byte
+CONSOLE_TX_DMA ?= 1
+
+ifeq ($(CONSOLE_TX_DMA),1)
+	DEFS       += -DCONSOLE_TX_DMA=1
+else
+	DEFS       += -DCONSOLE_TX_DMA=0
+endif
+
+####################################################################
+# Execute the listed SWD/JTAG bit-bang functions from RAM instead of flash,
+# e.g. make RAMFUNCS="SWD_TransferFast SWD_Sequence". Any of SWJ_Sequence,
+# SWD_Sequence, SWD_TransferFast, SWD_TransferBatchFast, JTAG_Sequence,
+# JTAG_IR_Fast, JTAG_IR_FastSingle, JTAG_TransferFast and
+# JTAG_TransferFastSingle can be listed. None are by default.
+RAMFUNCS       ?=
+
+DEFS           += $(foreach func,$(RAMFUNCS),-DRAMFUNC_$(func)=1)
+ifneq ($(strip $(RAMFUNCS)),)
+	DEFS       += -DDAP_RAMFUNCS=1
+endif
+
 ####################################################################
 # OpenOCD specific variables
 
@@ -47,7 +47,9 @@
 #ifndef __DAP_HAL_H__
 #define __DAP_HAL_H__
 
+#include <libopencm3/stm32/crc.h>
 #include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/rcc.h>
 #include "DAP/CMSIS_DAP_config.h"
 #include "tick.h"
 #include <libopencm3/cm3/systick.h>
@@ -64,6 +66,36 @@ static __inline uint32_t TIMESTAMP_GET (void) {
   return get_ticks();
 }
 
+// Get a free-running count of SysTick clock cycles and its rate, to
+// calibrate the SWJ clock delays against.
+static __inline uint32_t CLOCK_CALIBRATION_TIMER_GET (void) {
+  return get_timestamp();
+}
+
+static __inline uint32_t CLOCK_CALIBRATION_TIMER_COUNTS_PER_US (void) {
+  return get_timestamp_counts_per_us();
+}
+
+/*
+ * CRC SUPPORT
+ */
+
+// Restart the CRC unit: CRC-32/MPEG-2, polynomial 0x04C11DB7, initial
+// value 0xFFFFFFFF, no reflection or final XOR, fed MSB first one 32-bit
+// word at a time
+static __inline void CRC32_RESET (void) {
+  rcc_periph_clock_enable(RCC_CRC);
+  crc_reset();
+}
+
+static __inline void CRC32_ADD (uint32_t word) {
+  CRC_DR = word;
+}
+
+static __inline uint32_t CRC32_GET (void) {
+  return CRC_DR;
+}
+
 /*
 SWD functionality
 */
@@ -31,6 +31,7 @@
 #define VCDC_AVAILABLE 1
 #define VCDC_TX_BUFFER_SIZE 256
 #define VCDC_RX_BUFFER_SIZE 256
+#define RTT_AVAILABLE 0
 
 #define CDC_AVAILABLE 1
 #define DEFAULT_BAUDRATE 115200
@@ -50,6 +51,11 @@
 #define CONSOLE_RX_DMA_CONTROLLER DMA1
 #define CONSOLE_RX_DMA_CLOCK RCC_DMA
 #define CONSOLE_RX_DMA_CHANNEL DMA_CHANNEL5
+#define CONSOLE_RX_DMA_IRQ_NAME  dma1_channel4_7_dma2_channel3_5_isr
+#define CONSOLE_RX_DMA_NVIC_LINE NVIC_DMA1_CHANNEL4_7_DMA2_CHANNEL3_5_IRQ
+#define CONSOLE_TX_DMA_CONTROLLER DMA1
+#define CONSOLE_TX_DMA_CHANNEL DMA_CHANNEL4
+/* TX DMA completion is handled by the shared RX DMA interrupt */
 
 #define DFU_AVAILABLE 1
 #define nBOOT0_GPIO_CLOCK RCC_GPIOB
@@ -66,6 +72,8 @@
 #define BULK_AVAILABLE 1
 #define HID_AVAILABLE 0
 #define WINUSB_AVAILABLE 1
+#define SWO_STREAM_AVAILABLE 0
+#define PC_SAMPLE_AVAILABLE 0
 
 /* Word size for usart_recv and usart_send */
 typedef uint8_t usart_word_t;
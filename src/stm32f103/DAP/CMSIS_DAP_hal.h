@@ -47,7 +47,9 @@
 #ifndef __DAP_HAL_H__
 #define __DAP_HAL_H__
 
+#include <libopencm3/stm32/crc.h>
 #include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/rcc.h>
 #include "DAP/CMSIS_DAP_config.h"
 #include "tick.h"
 #include <libopencm3/cm3/systick.h>
@@ -64,6 +66,36 @@ static __inline uint32_t TIMESTAMP_GET (void) {
   return get_ticks();
 }
 
+// Get a free-running count of SysTick clock cycles and its rate, to
+// calibrate the SWJ clock delays against.
+static __inline uint32_t CLOCK_CALIBRATION_TIMER_GET (void) {
+  return get_timestamp();
+}
+
+static __inline uint32_t CLOCK_CALIBRATION_TIMER_COUNTS_PER_US (void) {
+  return get_timestamp_counts_per_us();
+}
+
+/*
+ * CRC SUPPORT
+ */
+
+// Restart the CRC unit: CRC-32/MPEG-2, polynomial 0x04C11DB7, initial
+// value 0xFFFFFFFF, no reflection or final XOR, fed MSB first one 32-bit
+// word at a time
+static __inline void CRC32_RESET (void) {
+  rcc_periph_clock_enable(RCC_CRC);
+  crc_reset();
+}
+
+static __inline void CRC32_ADD (uint32_t word) {
+  CRC_DR = word;
+}
+
+static __inline uint32_t CRC32_GET (void) {
+  return CRC_DR;
+}
+
 /*
 SWD functionality
 */
@@ -76,6 +108,12 @@ static __inline void PORT_SWD_SETUP (void)
     gpio_set_mode(SWDIO_GPIO_PORT, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_PUSHPULL, SWDIO_GPIO_PIN);
     gpio_set_mode(SWCLK_GPIO_PORT, GPIO_MODE_OUTPUT_50_MHZ, GPIO_CNF_OUTPUT_PUSHPULL, SWCLK_GPIO_PIN);
 
+#if (DAP_SWD_GANG != 0)
+    // The rest of the gang is only driven once a gang command is sent
+    gpio_set_mode(SWDIO_GPIO_PORT, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT,
+                  SWD_GANG_SWDIO_PINS & ~SWDIO_GPIO_PIN);
+#endif
+
 #if defined(JTDI_GPIO_PORT) && defined(JTDI_GPIO_PIN)
     GPIO_BRR(JTDI_GPIO_PORT) = JTDI_GPIO_PIN;
     gpio_set_mode(JTDI_GPIO_PORT, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT, JTDI_GPIO_PIN);
@@ -94,6 +132,11 @@ static __inline void PORT_OFF (void)
     gpio_set_mode(SWDIO_GPIO_PORT, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT, SWDIO_GPIO_PIN);
     gpio_set_mode(SWCLK_GPIO_PORT, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT, SWCLK_GPIO_PIN);
 
+#if (DAP_SWD_GANG != 0)
+    GPIO_BRR(SWDIO_GPIO_PORT) = SWD_GANG_SWDIO_PINS;
+    gpio_set_mode(SWDIO_GPIO_PORT, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT, SWD_GANG_SWDIO_PINS);
+#endif
+
 #if defined(JTDI_GPIO_PORT) && defined(JTDI_GPIO_PIN)
     GPIO_BRR(JTDI_GPIO_PORT) = JTDI_GPIO_PIN;
     gpio_set_mode(JTDI_GPIO_PORT, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT, JTDI_GPIO_PIN);
@@ -174,11 +217,83 @@ static __inline void     PIN_SWDIO_OUT_DISABLE (void)
 #endif
 }
 
+/*
+  SWD gang functionality
+
+  Every target of the gang shares SWCLK and has its own SWDIO pin on the
+  same GPIO port, so that a single BSRR write drives the clock and all of
+  the data lines at once. Pins are passed as masks of SWD_GANG_SWDIO_PINS.
+*/
+
+#if (DAP_SWD_GANG != 0)
+
+#if (SWCLK_GPIO_PORT != SWDIO_GPIO_PORT)
+#error "SWD gang mode needs SWCLK and SWDIO on the same GPIO port"
+#endif
+
+static __inline void SWD_GANG_PIN_MODES (uint32_t pins, uint32_t mode)
+{
+    uint32_t crl = 0;
+    uint32_t crh = 0;
+    uint32_t n;
+
+    for (n = 0; n < 8; n++) {
+        if (pins & (1UL << n)) {
+            crl |= 0xFUL << (n * 4);
+        }
+        if (pins & (0x100UL << n)) {
+            crh |= 0xFUL << (n * 4);
+        }
+    }
+    mode *= 0x11111111UL;
+    if (crl) {
+        GPIO_CRL(SWDIO_GPIO_PORT) = (GPIO_CRL(SWDIO_GPIO_PORT) & ~crl) | (mode & crl);
+    }
+    if (crh) {
+        GPIO_CRH(SWDIO_GPIO_PORT) = (GPIO_CRH(SWDIO_GPIO_PORT) & ~crh) | (mode & crh);
+    }
+}
+
+// Drive the SWDIO pins in pins high and the rest of the gang's low
+static __inline void PIN_SWD_GANG_OUT (uint32_t pins)
+{
+    GPIO_BSRR(SWDIO_GPIO_PORT) = pins | ((SWD_GANG_SWDIO_PINS & ~pins) << 16);
+}
+
+// Same as PIN_SWD_GANG_OUT, and SWCLK low in the same write
+static __inline void PIN_SWD_GANG_CLR_OUT (uint32_t pins)
+{
+    GPIO_BSRR(SWDIO_GPIO_PORT) = pins | (((SWD_GANG_SWDIO_PINS & ~pins) | SWCLK_GPIO_PIN) << 16);
+}
+
+static __inline uint32_t PIN_SWD_GANG_IN (void)
+{
+    return GPIO_IDR(SWDIO_GPIO_PORT) & SWD_GANG_SWDIO_PINS;
+}
+
+static __inline void PIN_SWD_GANG_OUT_ENABLE (uint32_t pins)
+{
+    SWD_GANG_PIN_MODES(pins, (GPIO_CNF_OUTPUT_PUSHPULL << 2) | GPIO_MODE_OUTPUT_50_MHZ);
+}
+
+static __inline void PIN_SWD_GANG_OUT_DISABLE (uint32_t pins)
+{
+    SWD_GANG_PIN_MODES(pins, (GPIO_CNF_INPUT_FLOAT << 2) | GPIO_MODE_INPUT);
+}
+
+#endif
+
 /*
   JTAG-only functionality
 */
 
 static __inline void PORT_JTAG_SETUP (void) {
+#if (DAP_SWD_GANG != 0)
+    // The rest of the gang isn't part of the scan chain
+    gpio_set_mode(SWDIO_GPIO_PORT, GPIO_MODE_INPUT, GPIO_CNF_INPUT_FLOAT,
+                  SWD_GANG_SWDIO_PINS & ~SWDIO_GPIO_PIN);
+#endif
+
     GPIO_BSRR(SWDIO_GPIO_PORT) = SWDIO_GPIO_PIN;
     GPIO_BSRR(SWCLK_GPIO_PORT) = SWCLK_GPIO_PIN;
 
@@ -60,10 +60,36 @@ This information includes:
 /// required.
 #define IO_PORT_WRITE_CYCLES    2U              ///< I/O Cycles: 2=default, 1=Cortex-M0+ fast I/0.
 
+/// Measure the SWJ clock delay loops against SysTick at boot, so that \ref DAP_SWJ_Clock
+/// selects the delay from measured cycle counts instead of the nominal cycle counts above.
+#define SWJ_CLOCK_CALIBRATION   1               ///< Calibration: 1 = enabled, 0 = disabled.
+
 /// Indicate that Serial Wire Debug (SWD) communication mode is available at the Debug Access Port.
 /// This information is returned by the command \ref DAP_Info as part of <b>Capabilities</b>.
 #define DAP_SWD                 1               ///< SWD Mode:  1 = available, 0 = not available.
 
+/// Indicate that a DAP_Transfer request without value match, match mask or timestamps is
+/// run as one batch, with the request headers taken from a table and the SWD settings
+/// loaded once per request. Costs a second copy of the SWD transfer code per clock mode.
+#define DAP_SWD_BATCH           1               ///< SWD batch: 1 = available, 0 = not available.
+
+/// Indicate that several identical targets can be driven in lockstep for gang programming.
+/// SWCLK is shared, and each target has its own SWDIO pin on the SWCLK port, listed in
+/// SWD_GANG_SWDIO_PINS. Requires a HAL with the SWD gang pin functions.
+#define DAP_SWD_GANG            1               ///< SWD Gang:  1 = available, 0 = not available.
+
+/// Indicate that a target on an SWD multidrop bus can be selected with the vendor command
+/// DAP_TargetSelect, and that the DP SELECT value is cached for each selected target.
+#define DAP_SWD_MULTIDROP       1               ///< SWD Multidrop: 1 = available, 0 = not available.
+
+/// Indicate that the vendor memory commands are available: memory read, write and CRC,
+/// and the register watch. Flash programming, RTT and PC sampling are built on them.
+#define DAP_MEMORY              1               ///< Memory:    1 = available, 0 = not available.
+
+/// Indicate that target flash can be programmed through a flash algorithm in target RAM
+/// with the vendor flash commands. Requires DAP_MEMORY.
+#define DAP_FLASH               1               ///< Flash:     1 = available, 0 = not available.
+
 /// Indicate that JTAG communication mode is available at the Debug Port.
 /// This information is returned by the command \ref DAP_Info as part of <b>Capabilities</b>.
 #if defined(CONF_JTAG)
@@ -89,51 +115,67 @@ This information includes:
 /// This configuration settings is used to optimize the communication performance with the
 /// debugger and depends on the USB peripheral. Typical vales are 64 for Full-speed USB HID or WinUSB,
 /// 1024 for High-speed USB HID and 512 for High-speed USB WinUSB.
+/// Bulk packets larger than 64 bytes are split across several USB packets.
+#if BULK_AVAILABLE
+#define DAP_PACKET_SIZE         512U            ///< Specifies Packet Size in bytes.
+#else
 #define DAP_PACKET_SIZE         64U             ///< Specifies Packet Size in bytes.
+#endif
 
 /// Maximum Package Buffers for Command and Response data.
 /// This configuration settings is used to optimize the communication performance with the
 /// debugger and depends on the USB peripheral. For devices with limited RAM or USB buffer the
 /// setting can be reduced (valid range is 1 .. 255).
+#if BULK_AVAILABLE
+#define DAP_PACKET_COUNT        4U              ///< Specifies number of packets buffered.
+#else
 #define DAP_PACKET_COUNT        12U             ///< Specifies number of packets buffered.
+#endif
 
+/// Each queue slot holds a request and its response; one extra slot tells a full queue from an empty one.
+#if BULK_AVAILABLE
+#define DAP_PACKET_QUEUE_SIZE (DAP_PACKET_COUNT+1)
+#else
 #define DAP_PACKET_QUEUE_SIZE (DAP_PACKET_COUNT+8)
+#endif
 
 /// Indicate that UART Serial Wire Output (SWO) trace is available.
 /// This information is returned by the command \ref DAP_Info as part of <b>Capabilities</b>.
-#define SWO_UART                0               ///< SWO UART:  1 = available, 0 = not available.
+#define SWO_UART                1               ///< SWO UART:  1 = available, 0 = not available.
 
 /// USART Driver instance number for the UART SWO.
+/// SWO is captured on the console USART RX pin, which is taken from the USB-serial bridge while in use.
 #define SWO_UART_DRIVER         0               ///< USART Driver instance number (Driver_USART#).
 
 /// Maximum SWO UART Baudrate.
-#define SWO_UART_MAX_BAUDRATE   10000000U       ///< SWO UART Maximum Baudrate in Hz.
+#define SWO_UART_MAX_BAUDRATE   2250000U        ///< SWO UART Maximum Baudrate in Hz.
 
 /// Indicate that Manchester Serial Wire Output (SWO) trace is available.
 /// This information is returned by the command \ref DAP_Info as part of <b>Capabilities</b>.
 #define SWO_MANCHESTER          0               ///< SWO Manchester:  1 = available, 0 = not available.
 
 /// SWO Trace Buffer Size.
-#define SWO_BUFFER_SIZE         4096U           ///< SWO Trace Buffer Size in bytes (must be 2^n).
+#define SWO_BUFFER_SIZE         CONSOLE_RX_BUFFER_SIZE ///< SWO Trace Buffer Size in bytes (must be 2^n).
 
 /// SWO Streaming Trace.
-#define SWO_STREAM              0               ///< SWO Streaming Trace: 1 = available, 0 = not available.
+#define SWO_STREAM              SWO_STREAM_AVAILABLE ///< SWO Streaming Trace: 1 = available, 0 = not available.
 
 /// Clock frequency of the Test Domain Timer. Timer value is returned with \ref TIMESTAMP_GET.
 #define TIMESTAMP_CLOCK         1000U           ///< Timestamp clock in Hz (0 = timestamps not supported).
 
 /// Indicate that UART Communication Port is available.
 /// This information is returned by the command \ref DAP_Info as part of <b>Capabilities</b>.
-#define DAP_UART                0               ///< DAP UART:  1 = available, 0 = not available.
+#define DAP_UART                1               ///< DAP UART:  1 = available, 0 = not available.
 
 /// USART Driver instance number for the UART Communication Port.
+/// The console USART is used, which is taken from the USB-serial bridge while DAP commands own it.
 #define DAP_UART_DRIVER         2               ///< USART Driver instance number (Driver_USART#).
 
 /// UART Receive Buffer Size.
-#define DAP_UART_RX_BUFFER_SIZE 4096U           ///< Uart Receive Buffer Size in bytes (must be 2^n).
+#define DAP_UART_RX_BUFFER_SIZE CONSOLE_RX_BUFFER_SIZE ///< Uart Receive Buffer Size in bytes (must be 2^n).
 
 /// UART Transmit Buffer Size.
-#define DAP_UART_TX_BUFFER_SIZE 128U            ///< Uart Transmit Buffer Size in bytes (must be 2^n).
+#define DAP_UART_TX_BUFFER_SIZE CONSOLE_TX_BUFFER_SIZE ///< Uart Transmit Buffer Size in bytes (must be 2^n).
 
 /// Indicate that UART Communication via USB COM Port is available.
 /// This information is returned by the command \ref DAP_Info as part of <b>Capabilities</b>.
@@ -186,4 +228,9 @@ static inline uint8_t DAP_GetProductString (char *str) {
 
 #define SWDIO_GPIO_PIN_NUM      14
 
+// Gang programming: board 0 is on SWDIO (PB14), boards 1-3 on PB10-PB12,
+// all sharing SWCLK (PB13)
+#define SWD_GANG_SWDIO_PINS     (GPIO14 | GPIO10 | GPIO11 | GPIO12)
+#define SWD_GANG_COUNT          4U
+
 #endif /* __DAP_CONFIG_H__ */
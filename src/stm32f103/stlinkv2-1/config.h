@@ -29,6 +29,7 @@
 #define VCDC_AVAILABLE 0
 #define VCDC_TX_BUFFER_SIZE 128
 #define VCDC_RX_BUFFER_SIZE 128
+#define RTT_AVAILABLE 0
 
 #define CDC_AVAILABLE 1
 #define DEFAULT_BAUDRATE 115200
@@ -50,6 +51,12 @@
 #define CONSOLE_RX_DMA_CONTROLLER DMA1
 #define CONSOLE_RX_DMA_CLOCK RCC_DMA1
 #define CONSOLE_RX_DMA_CHANNEL DMA_CHANNEL6
+#define CONSOLE_RX_DMA_IRQ_NAME  dma1_channel6_isr
+#define CONSOLE_RX_DMA_NVIC_LINE NVIC_DMA1_CHANNEL6_IRQ
+#define CONSOLE_TX_DMA_CONTROLLER DMA1
+#define CONSOLE_TX_DMA_CHANNEL DMA_CHANNEL7
+#define CONSOLE_TX_DMA_IRQ_NAME  dma1_channel7_isr
+#define CONSOLE_TX_DMA_NVIC_LINE NVIC_DMA1_CHANNEL7_IRQ
 
 #if PREFER_HID
 #define BULK_AVAILABLE 0
@@ -65,11 +72,16 @@
 #define WINUSB_AVAILABLE 1
 #endif
 
+/* No packet memory left for a SWO trace endpoint next to CDC */
+#define SWO_STREAM_AVAILABLE 0
+#define PC_SAMPLE_AVAILABLE 0
+
 /* Word size for usart_recv and usart_send */
 typedef uint16_t usart_word_t;
 
 /* Workaround for non-commonalized STM32F0 USART code */
 #define USART_RDR(usart_base) USART_DR(usart_base)
+#define USART_TDR(usart_base) USART_DR(usart_base)
 
 #define LED_OPEN_DRAIN         0
 
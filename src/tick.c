@@ -19,11 +19,15 @@
 #include <libopencm3/cm3/systick.h>
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/scb.h>
 
 #include "tick.h"
 
 volatile uint32_t __ticks = 0;
 
+static uint32_t tick_period_counts = 1;
+static uint32_t counts_per_us = 1;
+
 void sys_tick_handler(void)
 {
     __ticks++;
@@ -33,6 +37,11 @@ bool tick_setup(uint32_t tick_freq_hz) {
     bool success = false;
 
     if (systick_set_frequency(tick_freq_hz, rcc_ahb_frequency)) {
+        tick_period_counts = systick_get_reload() + 1;
+        counts_per_us = (tick_period_counts * tick_freq_hz) / 1000000U;
+        if (counts_per_us == 0) {
+            counts_per_us = 1;
+        }
         systick_clear();
         systick_interrupt_enable();
         success = true;
@@ -52,3 +61,25 @@ void tick_stop(void) {
 uint32_t get_ticks(void) {
     return __ticks;
 }
+
+uint32_t get_timestamp(void) {
+    uint32_t ticks;
+    uint32_t count;
+
+    do {
+        ticks = __ticks;
+        count = systick_get_value();
+        if (SCB_ICSR & SCB_ICSR_PENDSTSET) {
+            // The counter reloaded, but the tick has not been counted yet
+            // because we were called with the SysTick interrupt blocked.
+            count = systick_get_value();
+            ticks++;
+        }
+    } while ((ticks != __ticks) && (ticks != __ticks + 1));
+
+    return (ticks * tick_period_counts) + (tick_period_counts - 1 - count);
+}
+
+uint32_t get_timestamp_counts_per_us(void) {
+    return counts_per_us;
+}
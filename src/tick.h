@@ -27,4 +27,9 @@ extern volatile uint32_t __ticks;
 
 extern uint32_t get_ticks(void);
 
+/* Free-running count of SysTick clock cycles, for timing short intervals.
+ * Safe to call from interrupt handlers that block the SysTick interrupt. */
+extern uint32_t get_timestamp(void);
+extern uint32_t get_timestamp_counts_per_us(void);
+
 #endif